@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <chrono>
+#include <iterator>
 
 static double nowSeconds() {
     using clock = std::chrono::steady_clock;
@@ -11,10 +12,18 @@ static double nowSeconds() {
     return d.count();
 }
 
+void DataAssembler::noteResize(size_t& live, size_t oldBytes, size_t newBytes) {
+    if (newBytes == oldBytes) return;
+    // A capacity change is a fresh block; the old one is released
+    live += newBytes - oldBytes;
+    allocatedBytes += newBytes;
+}
+
 void DataAssembler::addChunk(const std::string& roverId, const LidarPacketHeader& hdr, const LidarPoint* pts, size_t count) {
     std::lock_guard<std::mutex> lk(mutex);
     PartialKey key{roverId, hdr.timestamp};
     auto& partial = partials[key];
+    const size_t bytesBefore = partial.bytes();
     if (partial.received.empty()) {
         partial.firstArrivalTs = nowSeconds();
         partial.totalChunks = hdr.totalChunks;
@@ -25,6 +34,7 @@ void DataAssembler::addChunk(const std::string& roverId, const LidarPacketHeader
         partial.received[hdr.chunkIndex] = true;
         partial.points.insert(partial.points.end(), pts, pts + count);
     }
+    noteResize(partialBytes, bytesBefore, partial.bytes());
     // Check completion
     bool all = true;
     for (bool r : partial.received) {
@@ -34,6 +44,8 @@ void DataAssembler::addChunk(const std::string& roverId, const LidarPacketHeader
         CompletedScan scan;
         scan.roverId = roverId;
         scan.timestamp = hdr.timestamp;
+        partialBytes -= partial.bytes();
+        completedBytes += partial.points.capacity() * sizeof(LidarPoint);
         scan.points = std::move(partial.points);
         partials.erase(key);
         completed.push_back(std::move(scan));
@@ -43,17 +55,33 @@ void DataAssembler::addChunk(const std::string& roverId, const LidarPacketHeader
 std::vector<CompletedScan> DataAssembler::retrieveCompleted() {
     std::lock_guard<std::mutex> lk(mutex);
     std::vector<CompletedScan> out;
-    out.insert(out.end(), completed.begin(), completed.end());
+    out.reserve(completed.size());
+    out.insert(out.end(), std::make_move_iterator(completed.begin()), std::make_move_iterator(completed.end()));
     completed.clear();
+    completedBytes = 0;
     return out;
 }
 
+MemoryUsage DataAssembler::getMemoryUsage() const {
+    std::lock_guard<std::mutex> lk(mutex);
+    MemoryUsage usage;
+    usage.liveBytes = liveBytes();
+    usage.allocatedBytes = allocatedBytes;
+    return usage;
+}
+
+void DataAssembler::setMemoryBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lk(mutex);
+    memoryBudget = bytes;
+}
+
 void DataAssembler::maintenance(double /*nowSec*/) {
     std::lock_guard<std::mutex> lk(mutex);
     // Drop stale partials (>200ms from first arrival)
     double t = nowSeconds();
     for (auto it = partials.begin(); it != partials.end();) {
         if (t - it->second.firstArrivalTs > 0.2) {
+            partialBytes -= it->second.bytes();
             it = partials.erase(it);
         } else {
             ++it;
@@ -62,16 +90,38 @@ void DataAssembler::maintenance(double /*nowSec*/) {
 
     // Optionally mirror completed points into a global point buffer
     if (storeGlobalPoints) {
-        auto tmp = completed; // copy so retrieveCompleted still returns them
-        for (const auto& sc : tmp) {
+        // Read in place; retrieveCompleted still returns them
+        const size_t bytesBefore = globalTerrain.capacity() * sizeof(LidarPoint);
+        for (const auto& sc : completed) {
             globalTerrain.insert(globalTerrain.end(), sc.points.begin(), sc.points.end());
         }
+        noteResize(globalBytes, bytesBefore, globalTerrain.capacity() * sizeof(LidarPoint));
         // Enforce cap if configured
         if (maxPointsGlobal > 0 && globalTerrain.size() > maxPointsGlobal) {
             size_t drop = globalTerrain.size() - maxPointsGlobal;
             globalTerrain.erase(globalTerrain.begin(), globalTerrain.begin() + static_cast<long>(drop));
         }
     }
-}
-
 
+    if (memoryBudget == 0 || evictableBytes() <= memoryBudget) return;
+    // Over budget: the mirrored points go first, oldest first, and the buffer gives its storage back
+    if (!globalTerrain.empty()) {
+        const size_t others = partialBytes;
+        const size_t keep = memoryBudget > others ? (memoryBudget - others) / sizeof(LidarPoint) : 0;
+        if (globalTerrain.size() > keep) {
+            const size_t drop = globalTerrain.size() - keep;
+            globalTerrain.erase(globalTerrain.begin(), globalTerrain.begin() + static_cast<long>(drop));
+        }
+        const size_t bytesBefore = globalTerrain.capacity() * sizeof(LidarPoint);
+        globalTerrain.shrink_to_fit();
+        noteResize(globalBytes, bytesBefore, globalTerrain.capacity() * sizeof(LidarPoint));
+    }
+    // Then the partial scans that have waited longest
+    while (evictableBytes() > memoryBudget && !partials.empty()) {
+        auto oldest = std::min_element(partials.begin(), partials.end(), [](const auto& a, const auto& b) {
+            return a.second.firstArrivalTs < b.second.firstArrivalTs;
+        });
+        partialBytes -= oldest->second.bytes();
+        partials.erase(oldest);
+    }
+}
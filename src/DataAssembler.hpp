@@ -8,12 +8,16 @@
 #include <vector>
 #include <deque>
 
+#include "MemoryMonitor.hpp"
 #include "NetworkTypes.h"
 
 struct CompletedScan {
     std::string roverId;
     double timestamp;
     std::vector<LidarPoint> points;
+    // Rover pose at timestamp, when the consumer has looked it up (see PoseHistory)
+    PosePacket pose{};
+    bool hasPose = false;
 };
 
 class DataAssembler {
@@ -32,6 +36,13 @@ public:
     // Maintenance, drop old partials and optionally fade
     void maintenance(double nowSeconds);
 
+    // Partial scans, completed scans not yet retrieved and the global point buffer
+    MemoryUsage getMemoryUsage() const;
+    // Over budget, maintenance drops the oldest global points, then the oldest partial scans
+    // (0 = unlimited). Completed scans are never dropped and do not count against it; the
+    // mapping thread's retrieval is what frees them.
+    void setMemoryBudget(size_t bytes);
+
 private:
     struct PartialKey {
         std::string roverId;
@@ -51,8 +62,15 @@ private:
         uint32_t totalChunks = 0;
         std::vector<bool> received;
         std::vector<LidarPoint> points; // will accumulate
+        size_t bytes() const { return points.capacity() * sizeof(LidarPoint) + received.capacity() / 8; }
     };
 
+    // Memory accounting, under the mutex
+    void noteResize(size_t& live, size_t oldBytes, size_t newBytes);
+    size_t liveBytes() const { return partialBytes + completedBytes + globalBytes; }
+    // What the budget covers: everything maintenance can drop
+    size_t evictableBytes() const { return partialBytes + globalBytes; }
+
     mutable std::mutex mutex;
     std::unordered_map<PartialKey, PartialScan, PartialKeyHash> partials;
     std::deque<CompletedScan> completed;
@@ -60,6 +78,12 @@ private:
     std::vector<LidarPoint> globalTerrain;
     size_t maxPointsGlobal = 2'000'000; // auto-tune later
     bool storeGlobalPoints = false;
+
+    size_t partialBytes = 0;
+    size_t completedBytes = 0;
+    size_t globalBytes = 0;
+    uint64_t allocatedBytes = 0;
+    size_t memoryBudget = 0;
 };
 
 
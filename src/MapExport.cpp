@@ -0,0 +1,394 @@
+#include "MapExport.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr float kNaN = std::numeric_limits<float>::quiet_NaN();
+constexpr size_t kPlyVertexBytes = 3 * sizeof(float);
+constexpr size_t kPlyFaceBytes = 1 + 3 * sizeof(int32_t);
+
+unsigned workerCount(unsigned threads, size_t jobs) {
+    if (threads == 0) {
+        // Leave the other half to the receivers and the mapping thread
+        unsigned hw = std::thread::hardware_concurrency();
+        threads = std::max(1u, hw / 2);
+    }
+    return static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, jobs)));
+}
+
+// Runs job(worker, index) for every index in [0, count) on `workers` threads. Stops handing
+// out work once a job fails; returns false in that case.
+template <typename Job>
+bool parallelFor(unsigned workers, size_t count, const Job& job) {
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    auto run = [&](unsigned w) {
+        while (!failed.load(std::memory_order_relaxed)) {
+            const size_t i = next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= count) break;
+            if (!job(w, i)) failed.store(true, std::memory_order_relaxed);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned w = 1; w < workers; ++w) pool.emplace_back(run, w);
+    run(0);
+    for (auto& t : pool) t.join();
+    return !failed.load();
+}
+
+// Preallocated output written at fixed offsets from any thread, renamed into place on commit
+class OutputFile {
+public:
+    ~OutputFile() {
+        if (fd < 0) return;
+        ::close(fd);
+        ::unlink(tmpPath.c_str());
+    }
+
+    bool open(const std::string& path, uint64_t size, std::string& error) {
+        finalPath = path;
+        tmpPath = path + ".part";
+        fd = ::open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            error = tmpPath + ": " + std::strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    bool write(const void* data, size_t size, uint64_t offset) const {
+        const auto* p = static_cast<const uint8_t*>(data);
+        while (size > 0) {
+            ssize_t n = ::pwrite(fd, p, size, static_cast<off_t>(offset));
+            if (n <= 0) return false;
+            p += n;
+            size -= static_cast<size_t>(n);
+            offset += static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+
+    bool commit(std::string& error) {
+        const bool closed = ::close(fd) == 0;
+        fd = -1;
+        if (!closed || std::rename(tmpPath.c_str(), finalPath.c_str()) != 0) {
+            error = finalPath + ": " + std::strerror(errno);
+            ::unlink(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    int fd = -1;
+    std::string tmpPath, finalPath;
+};
+
+// Inclusive tile range covering the region, or every held tile for an empty region
+bool tileRange(const ElevationMap& map, const std::vector<TileKey>& keys, const ExportRegion& region,
+               int& tx0, int& tz0, int& tx1, int& tz1) {
+    if (region.empty()) {
+        if (keys.empty()) return false;
+        tx0 = tx1 = keys.front().tx;
+        tz0 = tz1 = keys.front().tz;
+        for (const TileKey& k : keys) {
+            tx0 = std::min(tx0, k.tx); tx1 = std::max(tx1, k.tx);
+            tz0 = std::min(tz0, k.tz); tz1 = std::max(tz1, k.tz);
+        }
+        return true;
+    }
+    const float inv = 1.0f / map.getTileSize();
+    tx0 = static_cast<int>(std::floor(region.minX * inv));
+    tz0 = static_cast<int>(std::floor(region.minZ * inv));
+    tx1 = static_cast<int>(std::ceil(region.maxX * inv)) - 1;
+    tz1 = static_cast<int>(std::ceil(region.maxZ * inv)) - 1;
+    return tx1 >= tx0 && tz1 >= tz0;
+}
+
+bool holds(const std::vector<TileKey>& keys, const TileKey& key) {
+    return std::binary_search(keys.begin(), keys.end(), key);
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Triangles of the quad with corners a (x, z), b (x + 1, z), c (x, z + 1), d (x + 1, z + 1):
+// two when all are observed, one when a corner is missing
+int quadFaceCount(bool a, bool b, bool c, bool d) {
+    const int n = int(a) + int(b) + int(c) + int(d);
+    return n == 4 ? 2 : (n == 3 ? 1 : 0);
+}
+
+uint8_t* putFace(uint8_t* out, int32_t i0, int32_t i1, int32_t i2) {
+    *out++ = 3;
+    const int32_t idx[3] = {i0, i1, i2};
+    std::memcpy(out, idx, sizeof(idx));
+    return out + sizeof(idx);
+}
+
+// Corner indices < 0 are unobserved. Same winding as the renderer's terrain grid.
+uint8_t* putQuad(uint8_t* out, int32_t a, int32_t b, int32_t c, int32_t d) {
+    switch (quadFaceCount(a >= 0, b >= 0, c >= 0, d >= 0)) {
+        case 2:
+            out = putFace(out, a, c, b);
+            return putFace(out, b, c, d);
+        case 1:
+            if (a < 0) return putFace(out, b, c, d);
+            if (b < 0) return putFace(out, a, c, d);
+            if (c < 0) return putFace(out, a, d, b);
+            return putFace(out, a, c, b);
+        default:
+            return out;
+    }
+}
+}
+
+ExportResult exportHeightRaster(const ElevationMap& map, const std::string& path,
+                                const ExportRegion& region, unsigned threads) {
+    const auto start = std::chrono::steady_clock::now();
+    ExportResult res;
+    const std::vector<TileKey> keys = map.tileKeys();
+    int tx0 = 0, tz0 = 0, tx1 = 0, tz1 = 0;
+    if (!tileRange(map, keys, region, tx0, tz0, tx1, tz1)) {
+        res.error = "nothing to export";
+        return res;
+    }
+    const int side = map.getTileCells();
+    RasterHeader hdr;
+    hdr.tileX0 = tx0;
+    hdr.tileZ0 = tz0;
+    hdr.tilesX = static_cast<uint32_t>(tx1 - tx0 + 1);
+    hdr.tilesZ = static_cast<uint32_t>(tz1 - tz0 + 1);
+    hdr.side = static_cast<uint32_t>(side);
+    hdr.tileSize = map.getTileSize();
+    hdr.cellSize = map.getTileSize() / static_cast<float>(side);
+    const size_t blockBytes = static_cast<size_t>(side) * static_cast<size_t>(side) * sizeof(float);
+    const size_t blocks = static_cast<size_t>(hdr.tilesX) * hdr.tilesZ;
+    res.bytes = sizeof(RasterHeader) + static_cast<uint64_t>(blocks) * blockBytes;
+
+    OutputFile out;
+    if (!out.open(path, res.bytes, res.error)) return res;
+    if (!out.write(&hdr, sizeof(hdr), 0)) {
+        res.error = path + ": write failed";
+        return res;
+    }
+    const unsigned workers = workerCount(threads, blocks);
+    std::vector<std::vector<float>> scratch(workers);
+    std::atomic<size_t> tilesRead{0};
+    const bool written = parallelFor(workers, blocks, [&](unsigned w, size_t b) {
+        const TileKey key{tx0 + static_cast<int>(b % hdr.tilesX), tz0 + static_cast<int>(b / hdr.tilesX)};
+        std::vector<float>& block = scratch[w];
+        if (holds(keys, key) && map.copyTileHeights(key, block)) tilesRead.fetch_add(1, std::memory_order_relaxed);
+        else block.assign(blockBytes / sizeof(float), kNaN);
+        return out.write(block.data(), blockBytes, sizeof(RasterHeader) + static_cast<uint64_t>(b) * blockBytes);
+    });
+    if (!written) {
+        res.error = path + ": write failed";
+        return res;
+    }
+    if (!out.commit(res.error)) return res;
+    res.ok = true;
+    res.tiles = tilesRead.load();
+    res.seconds = secondsSince(start);
+    return res;
+}
+
+ExportResult exportPlyMesh(const ElevationMap& map, const std::string& path,
+                           const ExportRegion& region, unsigned threads) {
+    const auto start = std::chrono::steady_clock::now();
+    ExportResult res;
+    const std::vector<TileKey> keys = map.tileKeys();
+    const int side = map.getTileCells();
+    const float cellSize = map.getTileSize() / static_cast<float>(side);
+    // Global leaf-cell range [gx0, gx1) x [gz0, gz1)
+    int64_t gx0, gz0, gx1, gz1;
+    if (region.empty()) {
+        int tx0 = 0, tz0 = 0, tx1 = 0, tz1 = 0;
+        if (!tileRange(map, keys, region, tx0, tz0, tx1, tz1)) {
+            res.error = "nothing to export";
+            return res;
+        }
+        gx0 = int64_t(tx0) * side; gz0 = int64_t(tz0) * side;
+        gx1 = int64_t(tx1 + 1) * side; gz1 = int64_t(tz1 + 1) * side;
+    } else {
+        const float inv = 1.0f / cellSize;
+        gx0 = static_cast<int64_t>(std::floor(region.minX * inv));
+        gz0 = static_cast<int64_t>(std::floor(region.minZ * inv));
+        gx1 = static_cast<int64_t>(std::ceil(region.maxX * inv));
+        gz1 = static_cast<int64_t>(std::ceil(region.maxZ * inv));
+    }
+    const size_t cols = static_cast<size_t>(gx1 - gx0);
+    auto floorDiv = [side](int64_t g) { return static_cast<int>(g >= 0 ? g / side : -((-g + side - 1) / side)); };
+    const int tx0 = floorDiv(gx0), tx1 = floorDiv(gx1 - 1);
+    const int tz0 = floorDiv(gz0), tz1 = floorDiv(gz1 - 1);
+
+    // One band per tile row, clipped to the region
+    struct Band {
+        int64_t z0 = 0, z1 = 0;          // global cell rows
+        uint64_t vertices = 0;
+        uint64_t faces = 0;              // inside the band plus the seam to the next band
+        uint64_t vertexBase = 0, faceBase = 0;
+        std::vector<uint8_t> firstValid; // observed cells of the first and last row
+        std::vector<uint8_t> lastValid;
+    };
+    std::vector<Band> bands(static_cast<size_t>(tz1 - tz0 + 1));
+    for (size_t b = 0; b < bands.size(); ++b) {
+        const int64_t tileZ = int64_t(tz0) + static_cast<int64_t>(b);
+        bands[b].z0 = std::max(gz0, tileZ * side);
+        bands[b].z1 = std::min(gz1, (tileZ + 1) * side);
+    }
+
+    const unsigned workers = workerCount(threads, bands.size());
+    struct Scratch {
+        std::vector<float> heights, tile;
+        std::vector<int32_t> index;
+        std::vector<uint8_t> bytes;
+    };
+    std::vector<Scratch> scratch(workers);
+    std::atomic<size_t> tilesRead{0};
+    // Heights of a band, [row][col] relative to (z0, gx0), NaN where unobserved
+    auto loadBand = [&](Scratch& s, const Band& band, bool countTiles) {
+        const size_t rows = static_cast<size_t>(band.z1 - band.z0);
+        s.heights.assign(rows * cols, kNaN);
+        const int tileZ = floorDiv(band.z0);
+        for (int tx = tx0; tx <= tx1; ++tx) {
+            const TileKey key{tx, tileZ};
+            if (!holds(keys, key) || !map.copyTileHeights(key, s.tile)) continue;
+            if (countTiles) tilesRead.fetch_add(1, std::memory_order_relaxed);
+            const int64_t cx0 = std::max(gx0, int64_t(tx) * side), cx1 = std::min(gx1, int64_t(tx + 1) * side);
+            for (int64_t gz = band.z0; gz < band.z1; ++gz) {
+                const float* src = &s.tile[static_cast<size_t>(gz - int64_t(tileZ) * side) * side +
+                                           static_cast<size_t>(cx0 - int64_t(tx) * side)];
+                float* dst = &s.heights[static_cast<size_t>(gz - band.z0) * cols + static_cast<size_t>(cx0 - gx0)];
+                std::memcpy(dst, src, static_cast<size_t>(cx1 - cx0) * sizeof(float));
+            }
+        }
+    };
+
+    // Pass 1: vertex and face counts per band, and the edge rows the seams need
+    parallelFor(workers, bands.size(), [&](unsigned w, size_t b) {
+        Scratch& s = scratch[w];
+        Band& band = bands[b];
+        loadBand(s, band, true);
+        const size_t rows = static_cast<size_t>(band.z1 - band.z0);
+        auto ok = [&](size_t r, size_t c) { return !std::isnan(s.heights[r * cols + c]); };
+        for (size_t r = 0; r < rows; ++r) {
+            for (size_t c = 0; c < cols; ++c) {
+                band.vertices += ok(r, c);
+                if (r + 1 < rows && c + 1 < cols)
+                    band.faces += quadFaceCount(ok(r, c), ok(r, c + 1), ok(r + 1, c), ok(r + 1, c + 1));
+            }
+        }
+        band.firstValid.resize(cols);
+        band.lastValid.resize(cols);
+        for (size_t c = 0; c < cols; ++c) {
+            band.firstValid[c] = ok(0, c);
+            band.lastValid[c] = ok(rows - 1, c);
+        }
+        return true;
+    });
+    uint64_t vertices = 0, faces = 0;
+    for (size_t b = 0; b < bands.size(); ++b) {
+        Band& band = bands[b];
+        if (b + 1 < bands.size()) {
+            const Band& next = bands[b + 1];
+            for (size_t c = 0; c + 1 < cols; ++c)
+                band.faces += quadFaceCount(band.lastValid[c], band.lastValid[c + 1], next.firstValid[c], next.firstValid[c + 1]);
+        }
+        band.vertexBase = vertices;
+        band.faceBase = faces;
+        vertices += band.vertices;
+        faces += band.faces;
+    }
+    res.tiles = tilesRead.load();
+    if (vertices == 0) {
+        res.error = "nothing observed in the region";
+        return res;
+    }
+    if (vertices > static_cast<uint64_t>(std::numeric_limits<int32_t>::max())) {
+        res.error = "region too large for 32-bit vertex indices";
+        return res;
+    }
+
+    char header[512];
+    const int headerLen = std::snprintf(header, sizeof(header),
+        "ply\nformat binary_little_endian 1.0\n"
+        "comment elevation map, cell size %g m\n"
+        "element vertex %llu\nproperty float x\nproperty float y\nproperty float z\n"
+        "element face %llu\nproperty list uchar int vertex_indices\nend_header\n",
+        cellSize, static_cast<unsigned long long>(vertices), static_cast<unsigned long long>(faces));
+    const uint64_t vertexStart = static_cast<uint64_t>(headerLen);
+    const uint64_t faceStart = vertexStart + vertices * kPlyVertexBytes;
+    res.bytes = faceStart + faces * kPlyFaceBytes;
+    OutputFile out;
+    if (!out.open(path, res.bytes, res.error)) return res;
+    if (!out.write(header, static_cast<size_t>(headerLen), 0)) {
+        res.error = path + ": write failed";
+        return res;
+    }
+
+    // Pass 2: each band writes its vertices and faces at the offsets pass 1 fixed
+    const bool written = parallelFor(workers, bands.size(), [&](unsigned w, size_t b) {
+        Scratch& s = scratch[w];
+        const Band& band = bands[b];
+        loadBand(s, band, false);
+        const size_t rows = static_cast<size_t>(band.z1 - band.z0);
+        // Vertex index of every cell, plus one more row for the first row of the next band
+        s.index.assign((rows + 1) * cols, -1);
+        s.bytes.resize(static_cast<size_t>(std::max(band.vertices * kPlyVertexBytes, band.faces * kPlyFaceBytes)));
+        uint8_t* p = s.bytes.data();
+        int32_t next = static_cast<int32_t>(band.vertexBase);
+        for (size_t r = 0; r < rows; ++r) {
+            const float z = (static_cast<float>(band.z0 + static_cast<int64_t>(r)) + 0.5f) * cellSize;
+            for (size_t c = 0; c < cols; ++c) {
+                const float y = s.heights[r * cols + c];
+                if (std::isnan(y)) continue;
+                s.index[r * cols + c] = next++;
+                const float v[3] = {(static_cast<float>(gx0 + static_cast<int64_t>(c)) + 0.5f) * cellSize, y, z};
+                std::memcpy(p, v, sizeof(v));
+                p += sizeof(v);
+            }
+        }
+        if (!out.write(s.bytes.data(), static_cast<size_t>(p - s.bytes.data()),
+                       vertexStart + band.vertexBase * kPlyVertexBytes))
+            return false;
+        if (b + 1 < bands.size()) {
+            int32_t nextBand = static_cast<int32_t>(bands[b + 1].vertexBase);
+            for (size_t c = 0; c < cols; ++c) {
+                if (bands[b + 1].firstValid[c]) s.index[rows * cols + c] = nextBand++;
+            }
+        }
+        const size_t quadRows = b + 1 < bands.size() ? rows : rows - 1;
+        p = s.bytes.data();
+        for (size_t r = 0; r < quadRows; ++r) {
+            const int32_t* top = &s.index[r * cols];
+            const int32_t* bottom = &s.index[(r + 1) * cols];
+            for (size_t c = 0; c + 1 < cols; ++c) p = putQuad(p, top[c], top[c + 1], bottom[c], bottom[c + 1]);
+        }
+        return out.write(s.bytes.data(), static_cast<size_t>(p - s.bytes.data()),
+                         faceStart + band.faceBase * kPlyFaceBytes);
+    });
+    if (!written) {
+        res.error = path + ": write failed";
+        return res;
+    }
+    if (!out.commit(res.error)) return res;
+    res.ok = true;
+    res.vertices = vertices;
+    res.faces = faces;
+    res.seconds = secondsSince(start);
+    return res;
+}
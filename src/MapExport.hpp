@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "QuadtreeMap.hpp"
+
+// Streams an ElevationMap to disk tile by tile. Pass a snapshot: the mapping thread keeps
+// integrating while the export reads it, and spilled tiles are read from the shared tile store.
+// Each worker holds one tile (or one band of tile rows for meshes) at a time and writes its
+// blocks with pwrite at precomputed offsets, so memory stays bounded by the thread count and
+// the region width. Files are written next to the target and renamed into place when complete.
+//
+// Height raster (little endian): a 64-byte RasterHeader, then one side x side float32 block per
+// tile of the tile grid, tile rows (z) outer, cells z-major inside, NaN where unobserved or
+// where the map holds no tile. In numpy:
+//   h = np.fromfile(path, '<u4', 16); tilesX, tilesZ, side = h[6], h[7], h[8]
+//   r = np.memmap(path, '<f4', 'r', 64, (tilesZ, tilesX, side, side))
+//   grid = r.transpose(0, 2, 1, 3).reshape(tilesZ * side, tilesX * side)  # [z][x]
+//
+// Mesh: binary little-endian PLY with one vertex (x, y, z float) per observed leaf cell, at
+// the cell center and mean height, and two triangles per 2x2 block of observed cells (one
+// when a corner is missing), wound as the renderer's terrain.
+struct RasterHeader {
+    char magic[8] = {'E', 'L', 'E', 'V', 'R', 'A', 'S', 'T'};
+    uint32_t version = 1;
+    uint32_t headerBytes = 64;
+    int32_t tileX0 = 0, tileZ0 = 0; // key of the first block
+    uint32_t tilesX = 0, tilesZ = 0;
+    uint32_t side = 0;              // leaf cells per tile edge
+    float tileSize = 0.0f;          // meters; block (i, j) starts at ((tileX0 + i) * tileSize, (tileZ0 + j) * tileSize)
+    float cellSize = 0.0f;
+    uint32_t reserved[5] = {};
+};
+static_assert(sizeof(RasterHeader) == 64, "raster header is 64 bytes");
+
+// XZ rectangle to export; the default (empty) rectangle means every tile the map holds
+struct ExportRegion {
+    float minX = 0.0f, minZ = 0.0f, maxX = 0.0f, maxZ = 0.0f;
+    bool empty() const { return !(maxX > minX) || !(maxZ > minZ); }
+};
+
+struct ExportResult {
+    bool ok = false;
+    std::string error;
+    size_t tiles = 0;         // map tiles read
+    uint64_t bytes = 0;       // file size
+    uint64_t vertices = 0;    // mesh only
+    uint64_t faces = 0;
+    double seconds = 0.0;
+};
+
+// Tiles overlapping the region, snapped outward to tile bounds. threads = 0 leaves half the
+// cores to ingest.
+ExportResult exportHeightRaster(const ElevationMap& map, const std::string& path,
+                                const ExportRegion& region = {}, unsigned threads = 0);
+// Leaf cells overlapping the region, snapped outward to cell bounds
+ExportResult exportPlyMesh(const ElevationMap& map, const std::string& path,
+                           const ExportRegion& region = {}, unsigned threads = 0);
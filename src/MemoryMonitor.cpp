@@ -0,0 +1,51 @@
+#include "MemoryMonitor.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr double kRateSeconds = 1.0; // time constant of the rate average
+}
+
+const char* MemoryMonitor::name(MemorySubsystem s) {
+    switch (s) {
+        case MemorySubsystem::Network: return "Network";
+        case MemorySubsystem::Assembler: return "Assembler";
+        case MemorySubsystem::Map: return "Map";
+        case MemorySubsystem::Gpu: return "GPU";
+    }
+    return "?";
+}
+
+void MemoryMonitor::record(MemorySubsystem s, const MemoryUsage& usage, double nowSeconds) {
+    Entry& e = entries[index(s)];
+    e.peak = std::max(e.peak, usage.liveBytes);
+    const double dt = nowSeconds - e.lastSeconds;
+    if (e.lastSeconds >= 0.0 && dt <= 0.0) {
+        // Same instant: keep the allocation baseline so nothing drops out of the next rate
+        e.usage.liveBytes = usage.liveBytes;
+        return;
+    }
+    if (e.lastSeconds >= 0.0) {
+        // A counter that went backwards was reset; skip that interval
+        const double delta = usage.allocatedBytes >= e.usage.allocatedBytes
+                                 ? static_cast<double>(usage.allocatedBytes - e.usage.allocatedBytes)
+                                 : 0.0;
+        const double alpha = 1.0 - std::exp(-dt / kRateSeconds);
+        e.rate += alpha * (delta / dt - e.rate);
+    }
+    e.lastSeconds = nowSeconds;
+    e.usage = usage;
+}
+
+size_t MemoryMonitor::totalLiveBytes() const {
+    size_t total = 0;
+    for (const Entry& e : entries) total += e.usage.liveBytes;
+    return total;
+}
+
+float MemoryMonitor::budgetFraction(MemorySubsystem s) const {
+    const Entry& e = entry(s);
+    if (e.budget == 0) return 0.0f;
+    return static_cast<float>(static_cast<double>(e.usage.liveBytes) / static_cast<double>(e.budget));
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Memory held by one subsystem. Each subsystem keeps these counters up to date where it
+// allocates and releases, so reading them is O(1).
+struct MemoryUsage {
+    size_t liveBytes = 0;
+    uint64_t allocatedBytes = 0; // running total; its rate is the allocation rate
+};
+
+enum class MemorySubsystem { Network, Assembler, Map, Gpu };
+constexpr size_t kMemorySubsystems = 4;
+
+// Per-subsystem usage, peaks, allocation rates and budgets for the memory dashboard.
+// Budgets are only recorded here; the subsystems that own the memory enforce them.
+class MemoryMonitor {
+public:
+    static const char* name(MemorySubsystem s);
+
+    // Latest usage at nowSeconds; the allocation rate is smoothed over about a second
+    void record(MemorySubsystem s, const MemoryUsage& usage, double nowSeconds);
+
+    const MemoryUsage& usage(MemorySubsystem s) const { return entry(s).usage; }
+    size_t peakBytes(MemorySubsystem s) const { return entry(s).peak; }
+    double allocationRate(MemorySubsystem s) const { return entry(s).rate; } // bytes per second
+    size_t totalLiveBytes() const;
+
+    void setBudget(MemorySubsystem s, size_t bytes) { entries[index(s)].budget = bytes; } // 0 = none
+    size_t budget(MemorySubsystem s) const { return entry(s).budget; }
+    // Live bytes over the budget, 0 without one
+    float budgetFraction(MemorySubsystem s) const;
+
+private:
+    struct Entry {
+        MemoryUsage usage;
+        size_t peak = 0;
+        size_t budget = 0;
+        double rate = 0.0;
+        double lastSeconds = -1.0;
+    };
+    static size_t index(MemorySubsystem s) { return static_cast<size_t>(s); }
+    const Entry& entry(MemorySubsystem s) const { return entries[index(s)]; }
+
+    std::array<Entry, kMemorySubsystems> entries{};
+};
@@ -0,0 +1,80 @@
+#include "MotionGate.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "ScanBinning.hpp"
+
+namespace {
+constexpr uint64_t kEmptyCell = ~0ull; // no biased cell key reaches this
+
+float angleDeltaDeg(float a, float b) {
+    float d = std::fmod(std::fabs(a - b), 360.0f);
+    return d > 180.0f ? 360.0f - d : d;
+}
+}
+
+size_t MotionGate::gateScans(std::vector<CompletedScan>& scans) {
+    const size_t before = scans.size();
+    scans.erase(std::remove_if(scans.begin(), scans.end(), [this](const CompletedScan& sc) { return !admit(sc); }),
+                scans.end());
+    return before - scans.size();
+}
+
+bool MotionGate::admit(const CompletedScan& scan) {
+    seen.fetch_add(1, std::memory_order_relaxed);
+    RoverGate& g = gates[scan.roverId];
+    const PosePacket& pose = scan.pose;
+    const bool havePose = scan.hasPose;
+
+    bool changed = !g.haveReference || policy.keepEveryN <= 1 || g.skippedInRow + 1 >= policy.keepEveryN;
+    if (!changed && havePose && g.referenceHasPose) {
+        const PosePacket& r = g.referencePose;
+        float dx = pose.posX - r.posX, dy = pose.posY - r.posY, dz = pose.posZ - r.posZ;
+        float turn = std::max({angleDeltaDeg(pose.rotXdeg, r.rotXdeg), angleDeltaDeg(pose.rotYdeg, r.rotYdeg),
+                               angleDeltaDeg(pose.rotZdeg, r.rotZdeg)});
+        changed = dx * dx + dy * dy + dz * dz > policy.minTranslation * policy.minTranslation ||
+                  turn > policy.minRotationDeg;
+    }
+    if (!changed) changed = novelFraction(g, scan.points) > 1.0f - policy.maxOverlap;
+    if (!changed) {
+        g.skippedInRow++;
+        skipped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    g.skippedInRow = 0;
+    g.haveReference = true;
+    g.referenceHasPose = havePose;
+    g.referencePose = pose;
+    setReferenceCells(g, scan.points);
+    return true;
+}
+
+float MotionGate::novelFraction(const RoverGate& g, const std::vector<LidarPoint>& points) const {
+    const size_t stride = static_cast<size_t>(std::max(policy.sampleStride, 1));
+    const float inv = 1.0f / std::max(policy.overlapCellSize, 1e-3f);
+    size_t sampled = 0, novel = 0;
+    for (size_t i = 0; i < points.size(); i += stride) {
+        const uint64_t key = packCellKey(floorToInt(points[i].x * inv), floorToInt(points[i].z * inv));
+        uint64_t slot = hashCellKey(key) & g.cellMask;
+        while (g.cells[slot] != kEmptyCell && g.cells[slot] != key) slot = (slot + 1) & g.cellMask;
+        sampled++;
+        if (g.cells[slot] == kEmptyCell) novel++;
+    }
+    return sampled ? static_cast<float>(novel) / static_cast<float>(sampled) : 0.0f;
+}
+
+void MotionGate::setReferenceCells(RoverGate& g, const std::vector<LidarPoint>& points) {
+    // Every point goes in, so the sampled test of later scans sees the full coverage
+    size_t capacity = 16;
+    while (capacity < 2 * points.size()) capacity <<= 1;
+    g.cells.assign(capacity, kEmptyCell);
+    g.cellMask = capacity - 1;
+    const float inv = 1.0f / std::max(policy.overlapCellSize, 1e-3f);
+    for (const LidarPoint& p : points) {
+        const uint64_t key = packCellKey(floorToInt(p.x * inv), floorToInt(p.z * inv));
+        uint64_t slot = hashCellKey(key) & g.cellMask;
+        while (g.cells[slot] != kEmptyCell && g.cells[slot] != key) slot = (slot + 1) & g.cellMask;
+        g.cells[slot] = key;
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "DataAssembler.hpp"
+#include "NetworkTypes.h"
+
+// Per-rover gate in front of map integration that drops scans which cannot show anything
+// new. A scan is integrated when the rover moved or turned since the last integrated scan,
+// when too few of its (sampled) points land on coarse cells that scan covered, or as the
+// keep-every-Nth refresh; otherwise it is skipped. Pose thresholds sit above the pose noise
+// so a parked rover does not look like it is moving.
+struct MotionGatePolicy {
+    float minTranslation = 3.0f;  // meters
+    float minRotationDeg = 5.0f;  // largest per-axis change
+    float maxOverlap = 0.9f;      // integrate when less than this fraction falls on covered cells
+    float overlapCellSize = 2.0f; // meters
+    int sampleStride = 8;         // overlap test looks at every Nth point
+    int keepEveryN = 10;          // integrate at least every Nth scan; 1 disables skipping
+};
+
+class MotionGate {
+public:
+    void setPolicy(const MotionGatePolicy& p) { policy = p; }
+    const MotionGatePolicy& getPolicy() const { return policy; }
+
+    // Decides one scan (using its pose when it has one) and updates the rover's reference when it passes
+    bool admit(const CompletedScan& scan);
+    // Removes the scans admit() turns down; returns how many
+    size_t gateScans(std::vector<CompletedScan>& scans);
+
+    // Running totals; safe to read from any thread
+    uint64_t scansSeen() const { return seen.load(std::memory_order_relaxed); }
+    uint64_t scansSkipped() const { return skipped.load(std::memory_order_relaxed); }
+
+private:
+    struct RoverGate {
+        bool haveReference = false;
+        bool referenceHasPose = false;
+        PosePacket referencePose{};
+        int skippedInRow = 0;
+        std::vector<uint64_t> cells; // open-addressed coarse cell keys of the reference scan
+        uint64_t cellMask = 0;
+    };
+
+    float novelFraction(const RoverGate& g, const std::vector<LidarPoint>& points) const;
+    void setReferenceCells(RoverGate& g, const std::vector<LidarPoint>& points);
+
+    MotionGatePolicy policy;
+    std::map<std::string, RoverGate> gates;
+
+    std::atomic<uint64_t> seen{0};
+    std::atomic<uint64_t> skipped{0};
+};
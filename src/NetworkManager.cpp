@@ -72,10 +72,22 @@ StreamTimestamps NetworkManager::getStreamTimestamps(const std::string& roverId)
     return it == tsByRover.end() ? StreamTimestamps{} : it->second;
 }
 
+MemoryUsage NetworkManager::getMemoryUsage() const {
+    MemoryUsage usage;
+    usage.liveBytes = bufferBytes.load(std::memory_order_relaxed);
+    usage.allocatedBytes = receivedBytes.load(std::memory_order_relaxed);
+    return usage;
+}
+
 void NetworkManager::runReceiver(const std::string& roverId, int port, char streamType) {
     int sock = createUdpSocketBind(port);
     if (sock < 0) return;
     std::vector<uint8_t> buffer(65536);
+    int kernelBytes = 0;
+    socklen_t optLen = sizeof(kernelBytes);
+    if (getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &kernelBytes, &optLen) < 0) kernelBytes = 0;
+    const size_t held = buffer.capacity() + static_cast<size_t>(kernelBytes);
+    bufferBytes.fetch_add(held, std::memory_order_relaxed);
 
     while (running.load()) {
         ssize_t n = recv(sock, buffer.data(), buffer.size(), 0);
@@ -84,6 +96,7 @@ void NetworkManager::runReceiver(const std::string& roverId, int port, char stre
             std::this_thread::sleep_for(5ms);
             continue;
         }
+        receivedBytes.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
         if (streamType == 'p' && static_cast<size_t>(n) >= sizeof(PosePacket)) {
             const auto* pkt = reinterpret_cast<const PosePacket*>(buffer.data());
             {
@@ -110,6 +123,7 @@ void NetworkManager::runReceiver(const std::string& roverId, int port, char stre
         }
     }
     ::close(sock);
+    bufferBytes.fetch_sub(held, std::memory_order_relaxed);
 }
 
 
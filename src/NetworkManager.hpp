@@ -9,6 +9,7 @@
 #include <thread>
 #include <vector>
 
+#include "MemoryMonitor.hpp"
 #include "NetworkTypes.h"
 
 struct StreamTimestamps {
@@ -40,6 +41,10 @@ public:
 
     StreamTimestamps getStreamTimestamps(const std::string& roverId) const;
 
+    // Receive buffers of the open sockets (ours plus the kernel's SO_RCVBUF) and the datagram
+    // bytes copied into them so far; safe to read from any thread
+    MemoryUsage getMemoryUsage() const;
+
 private:
     void runReceiver(const std::string& roverId, int port, char streamType);
 
@@ -51,6 +56,9 @@ private:
 
     mutable std::mutex tsMutex;
     std::map<std::string, StreamTimestamps> tsByRover;
+
+    std::atomic<size_t> bufferBytes{0};
+    std::atomic<uint64_t> receivedBytes{0};
 };
 
 
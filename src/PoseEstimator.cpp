@@ -0,0 +1,97 @@
+#include "PoseEstimator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+// Alpha-beta gains for position and yaw
+constexpr float kPosGain = 0.25f;
+constexpr float kVelGain = 0.6f;
+constexpr float kYawGain = 0.25f;
+constexpr float kYawRateGain = 0.6f;
+constexpr float kNoiseAlpha = 0.1f;
+constexpr double kFirstStepSeconds = 0.1;
+
+float normYaw(float yaw) {
+    while (yaw > 180.0f) yaw -= 360.0f;
+    while (yaw < -180.0f) yaw += 360.0f;
+    return yaw;
+}
+}
+
+int PoseEstimator::addRover(const std::string& roverId) {
+    auto it = indices.find(roverId);
+    if (it != indices.end()) return it->second;
+    const int index = static_cast<int>(tracks.size());
+    tracks.push_back(std::make_unique<Track>());
+    indices.emplace(roverId, index);
+    return index;
+}
+
+int PoseEstimator::indexOf(const std::string& roverId) const {
+    auto it = indices.find(roverId);
+    return it != indices.end() ? it->second : -1;
+}
+
+void PoseEstimator::update(int index, const PosePacket& pose) {
+    if (index < 0 || static_cast<size_t>(index) >= tracks.size()) return;
+    Track& t = *tracks[index];
+    PoseEstimate& s = t.state;
+
+    if (!t.initialized) {
+        s.smoothX = pose.posX; s.smoothY = pose.posY; s.smoothZ = pose.posZ;
+        s.velX = s.velY = s.velZ = 0.0f;
+        s.smoothRotYdeg = normYaw(pose.rotYdeg);
+        s.yawRateDeg = 0.0f;
+        s.noiseScore = 0.0f;
+        t.initialized = true;
+    } else {
+        const double dtd = t.lastTs > 0.0 ? std::max(1e-3, pose.timestamp - t.lastTs) : kFirstStepSeconds;
+        const float dt = static_cast<float>(dtd);
+        // Predict
+        s.smoothX += s.velX * dt; s.smoothY += s.velY * dt; s.smoothZ += s.velZ * dt;
+        s.smoothRotYdeg = normYaw(s.smoothRotYdeg + s.yawRateDeg * dt);
+        // Correct with the innovation
+        const float rx = pose.posX - s.smoothX, ry = pose.posY - s.smoothY, rz = pose.posZ - s.smoothZ;
+        const float ryaw = normYaw(normYaw(pose.rotYdeg) - s.smoothRotYdeg);
+        s.smoothX += kPosGain * rx; s.smoothY += kPosGain * ry; s.smoothZ += kPosGain * rz;
+        const float hv = kVelGain / dt;
+        s.velX += hv * rx; s.velY += hv * ry; s.velZ += hv * rz;
+        s.smoothRotYdeg = normYaw(s.smoothRotYdeg + kYawGain * ryaw);
+        s.yawRateDeg += (kYawRateGain / dt) * ryaw;
+        // Jitter score: EMA of the displacement between consecutive measurements
+        const float dx = pose.posX - s.posX, dy = pose.posY - s.posY, dz = pose.posZ - s.posZ;
+        s.noiseScore = (1.0f - kNoiseAlpha) * s.noiseScore + kNoiseAlpha * std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+    t.lastTs = pose.timestamp;
+    s.smoothRotXdeg = pose.rotXdeg;
+    s.smoothRotZdeg = pose.rotZdeg;
+    s.posX = pose.posX; s.posY = pose.posY; s.posZ = pose.posZ;
+    s.rotXdeg = pose.rotXdeg; s.rotYdeg = pose.rotYdeg; s.rotZdeg = pose.rotZdeg;
+    s.timestamp = pose.timestamp;
+
+    uint64_t words[kWords];
+    std::memcpy(words, &s, sizeof(words));
+    const uint32_t seq = t.seq.load(std::memory_order_relaxed);
+    t.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kWords; ++i) t.words[i].store(words[i], std::memory_order_relaxed);
+    t.seq.store(seq + 2, std::memory_order_release);
+}
+
+bool PoseEstimator::latest(int index, PoseEstimate& out) const {
+    if (index < 0 || static_cast<size_t>(index) >= tracks.size()) return false;
+    const Track& t = *tracks[index];
+    while (true) {
+        const uint32_t before = t.seq.load(std::memory_order_acquire);
+        if (before == 0) return false; // nothing published yet
+        if (before & 1u) continue;     // writer is mid-update
+        uint64_t words[kWords];
+        for (size_t i = 0; i < kWords; ++i) words[i] = t.words[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (t.seq.load(std::memory_order_relaxed) != before) continue;
+        std::memcpy(&out, words, sizeof(words));
+        return true;
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "NetworkTypes.h"
+
+// Filtered rover pose as published by PoseEstimator. Angles in degrees, as in PosePacket.
+struct PoseEstimate {
+    // Latest measurement
+    float posX = 0.0f, posY = 0.0f, posZ = 0.0f;
+    float rotXdeg = 0.0f, rotYdeg = 0.0f, rotZdeg = 0.0f;
+    // Smoothed state (alpha-beta filtered position and yaw; roll/pitch pass through)
+    float smoothX = 0.0f, smoothY = 0.0f, smoothZ = 0.0f;
+    float smoothRotXdeg = 0.0f, smoothRotYdeg = 0.0f, smoothRotZdeg = 0.0f;
+    float velX = 0.0f, velY = 0.0f, velZ = 0.0f;
+    float yawRateDeg = 0.0f;
+    // Rolling estimate of pose jitter magnitude (meters)
+    float noiseScore = 0.0f;
+    float reserved = 0.0f;
+    double timestamp = 0.0;
+};
+
+// Per-rover alpha-beta (g-h) pose filter with lock-free publication of the latest estimate.
+// Rovers are registered up front; after that the set never changes shape, so update() and
+// latest() need no lock. Each rover has a single writer (its pose receiver thread) that
+// runs the filter and publishes through a seqlock; any number of readers (renderer, mapper)
+// copy the newest estimate and retry only if they raced a write.
+class PoseEstimator {
+public:
+    PoseEstimator() = default;
+    PoseEstimator(const PoseEstimator&) = delete;
+    PoseEstimator& operator=(const PoseEstimator&) = delete;
+
+    // Setup only, before any update() or latest(); returns the rover's index
+    int addRover(const std::string& roverId);
+    // Index of a registered rover, or -1
+    int indexOf(const std::string& roverId) const;
+    size_t roverCount() const { return tracks.size(); }
+
+    // Feeds a pose measurement; one writer thread per rover. Unknown rovers are ignored.
+    void update(int index, const PosePacket& pose);
+    void update(const std::string& roverId, const PosePacket& pose) { update(indexOf(roverId), pose); }
+
+    // Newest estimate; false before the rover's first pose
+    bool latest(int index, PoseEstimate& out) const;
+
+private:
+    static constexpr size_t kWords = sizeof(PoseEstimate) / sizeof(uint64_t);
+    static_assert(sizeof(PoseEstimate) % sizeof(uint64_t) == 0, "PoseEstimate must fill whole words");
+
+    struct Track {
+        // Filter state, writer only
+        bool initialized = false;
+        double lastTs = 0.0;
+        PoseEstimate state;
+        // Published copy of state
+        std::atomic<uint32_t> seq{0}; // odd while being written
+        std::array<std::atomic<uint64_t>, kWords> words{};
+    };
+
+    std::vector<std::unique_ptr<Track>> tracks;
+    std::map<std::string, int> indices;
+};
@@ -0,0 +1,170 @@
+#include "PoseHistory.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+// Slots the writer may overwrite while a lookup is still walking the ring
+constexpr uint64_t kLapSlack = 8;
+constexpr double kRestartJumpSeconds = 1.0;
+constexpr double kDegToRad = 3.14159265358979323846 / 180.0;
+
+struct Quat {
+    double w, x, y, z;
+};
+
+Quat mul(const Quat& a, const Quat& b) {
+    return Quat{a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+                a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+                a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+                a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w};
+}
+
+Quat fromEulerDeg(float rx, float ry, float rz) {
+    double hx = 0.5 * rx * kDegToRad, hy = 0.5 * ry * kDegToRad, hz = 0.5 * rz * kDegToRad;
+    Quat qx{std::cos(hx), std::sin(hx), 0.0, 0.0};
+    Quat qy{std::cos(hy), 0.0, std::sin(hy), 0.0};
+    Quat qz{std::cos(hz), 0.0, 0.0, std::sin(hz)};
+    return mul(mul(qy, qx), qz);
+}
+
+void toEulerDeg(const Quat& q, float& rx, float& ry, float& rz) {
+    // Matrix terms of Ry * Rx * Rz: m12 = -sin(x), m02 / m22 give y, m10 / m11 give z
+    double m12 = 2.0 * (q.y * q.z - q.w * q.x);
+    double m02 = 2.0 * (q.x * q.z + q.w * q.y);
+    double m22 = 1.0 - 2.0 * (q.x * q.x + q.y * q.y);
+    double m10 = 2.0 * (q.x * q.y + q.w * q.z);
+    double m11 = 1.0 - 2.0 * (q.x * q.x + q.z * q.z);
+    rx = static_cast<float>(std::asin(std::clamp(-m12, -1.0, 1.0)) / kDegToRad);
+    ry = static_cast<float>(std::atan2(m02, m22) / kDegToRad);
+    rz = static_cast<float>(std::atan2(m10, m11) / kDegToRad);
+}
+
+Quat slerp(const Quat& a, Quat b, double u) {
+    double d = a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+    if (d < 0.0) {
+        // Take the short way round
+        b = Quat{-b.w, -b.x, -b.y, -b.z};
+        d = -d;
+    }
+    double wa, wb;
+    if (d > 0.9995) {
+        wa = 1.0 - u;
+        wb = u;
+    } else {
+        double theta = std::acos(d);
+        double s = std::sin(theta);
+        wa = std::sin((1.0 - u) * theta) / s;
+        wb = std::sin(u * theta) / s;
+    }
+    Quat q{wa * a.w + wb * b.w, wa * a.x + wb * b.x, wa * a.y + wb * b.y, wa * a.z + wb * b.z};
+    double n = std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+    return Quat{q.w / n, q.x / n, q.y / n, q.z / n};
+}
+}
+
+PosePacket PoseHistory::interpolate(const PosePacket& a, const PosePacket& b, double u) {
+    PosePacket out;
+    const float uf = static_cast<float>(u);
+    out.timestamp = a.timestamp + (b.timestamp - a.timestamp) * u;
+    out.posX = a.posX + (b.posX - a.posX) * uf;
+    out.posY = a.posY + (b.posY - a.posY) * uf;
+    out.posZ = a.posZ + (b.posZ - a.posZ) * uf;
+    Quat q = slerp(fromEulerDeg(a.rotXdeg, a.rotYdeg, a.rotZdeg), fromEulerDeg(b.rotXdeg, b.rotYdeg, b.rotZdeg), u);
+    toEulerDeg(q, out.rotXdeg, out.rotYdeg, out.rotZdeg);
+    return out;
+}
+
+void PoseHistory::push(const PosePacket& pose) {
+    const uint64_t n = count.load(std::memory_order_relaxed);
+    if (n > firstSerial.load(std::memory_order_relaxed) && pose.timestamp <= newestTs) {
+        if (pose.timestamp > newestTs - kRestartJumpSeconds) return; // late or duplicate packet
+        firstSerial.store(n, std::memory_order_release);
+    }
+    Slot& s = slots[n % kCapacity];
+    const uint32_t seq = s.seq.load(std::memory_order_relaxed);
+    s.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    uint64_t words[4];
+    std::memcpy(words, &pose, sizeof(words));
+    s.serial.store(n, std::memory_order_relaxed);
+    for (size_t i = 0; i < 4; ++i) s.words[i].store(words[i], std::memory_order_relaxed);
+    s.seq.store(seq + 2, std::memory_order_release);
+    count.store(n + 1, std::memory_order_release);
+    newestTs = pose.timestamp;
+}
+
+bool PoseHistory::read(uint64_t serial, PosePacket& out) const {
+    const Slot& s = slots[serial % kCapacity];
+    while (true) {
+        const uint32_t before = s.seq.load(std::memory_order_acquire);
+        if (before & 1u) continue; // writer is mid-update
+        const uint64_t held = s.serial.load(std::memory_order_relaxed);
+        uint64_t words[4];
+        for (size_t i = 0; i < 4; ++i) words[i] = s.words[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.seq.load(std::memory_order_relaxed) != before) continue;
+        if (held != serial) return false;
+        std::memcpy(&out, words, sizeof(words));
+        return true;
+    }
+}
+
+size_t PoseHistory::size() const {
+    const uint64_t n = count.load(std::memory_order_acquire);
+    const uint64_t first = firstSerial.load(std::memory_order_acquire);
+    return static_cast<size_t>(std::min<uint64_t>(n - first, kCapacity));
+}
+
+bool PoseHistory::latest(PosePacket& out) const {
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        const uint64_t n = count.load(std::memory_order_acquire);
+        if (n == 0) return false;
+        if (read(n - 1, out)) return true;
+    }
+    return false;
+}
+
+bool PoseHistory::sampleAt(double t, PosePacket& out) const {
+    // A retry only happens when the writer laps the lookup, which takes ~kCapacity poses
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        const uint64_t n = count.load(std::memory_order_acquire);
+        if (n == 0) return false;
+        const uint64_t newest = n - 1;
+        uint64_t oldest = std::max(firstSerial.load(std::memory_order_acquire),
+                                   n > kCapacity - kLapSlack ? n - (kCapacity - kLapSlack) : 0);
+        PosePacket lo, hi;
+        if (!read(newest, hi)) continue;
+        if (t >= hi.timestamp || oldest >= newest) {
+            out = hi;
+            return true;
+        }
+        if (!read(oldest, lo)) continue;
+        if (t <= lo.timestamp) {
+            out = lo;
+            return true;
+        }
+        // Predict the bracketing slot from the average spacing, then walk the last step or two
+        const double frac = (t - lo.timestamp) / (hi.timestamp - lo.timestamp);
+        uint64_t idx = oldest + static_cast<uint64_t>(frac * static_cast<double>(newest - oldest));
+        idx = std::min(std::max(idx, oldest), newest - 1);
+        PosePacket a, b;
+        bool ok = read(idx, a) && read(idx + 1, b);
+        while (ok && a.timestamp > t) {
+            --idx;
+            b = a;
+            ok = read(idx, a);
+        }
+        while (ok && b.timestamp <= t) {
+            ++idx;
+            a = b;
+            ok = read(idx + 1, b);
+        }
+        if (!ok) continue;
+        out = interpolate(a, b, (t - a.timestamp) / (b.timestamp - a.timestamp));
+        out.timestamp = t;
+        return true;
+    }
+    return false;
+}
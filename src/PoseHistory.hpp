@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "NetworkTypes.h"
+
+// Recent poses of one rover, for looking up where it was when a scan was taken.
+// A single writer (the rover's pose receiver) appends without locking; any number of
+// readers look up concurrently. Each slot is a small seqlock, so a reader that races the
+// writer simply retries. Lookups start from the slot predicted by the average sample
+// spacing and are O(1) for the near-uniform pose rate of a rover.
+//
+// Between two samples position is interpolated linearly and rotation by SLERP. Euler
+// angles follow PosePacket (degrees) and are composed as Ry(rotY) * Rx(rotX) * Rz(rotZ).
+class PoseHistory {
+public:
+    static constexpr size_t kCapacity = 256; // ~25 s at 10 Hz
+
+    PoseHistory() = default;
+    PoseHistory(const PoseHistory&) = delete;
+    PoseHistory& operator=(const PoseHistory&) = delete;
+
+    // Appends a pose; samples not newer than the last one are dropped, unless the clock jumped
+    // back by more than a second (emulator restart), which starts the history over. Writer thread only.
+    void push(const PosePacket& pose);
+
+    // Pose at time t, clamped to the oldest/newest sample (no extrapolation). False when empty.
+    bool sampleAt(double t, PosePacket& out) const;
+    bool latest(PosePacket& out) const;
+    size_t size() const;
+
+    // Interpolates between two poses, u in [0, 1]; timestamp is interpolated too
+    static PosePacket interpolate(const PosePacket& a, const PosePacket& b, double u);
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> seq{0};       // odd while being written
+        std::atomic<uint64_t> serial{0};    // absolute index of the pose held
+        std::array<std::atomic<uint64_t>, 4> words{};
+    };
+    static_assert(sizeof(PosePacket) == 4 * sizeof(uint64_t), "PosePacket must fill four words");
+
+    // Copies the pose with absolute index serial; false if it is not (or no longer) held
+    bool read(uint64_t serial, PosePacket& out) const;
+
+    std::array<Slot, kCapacity> slots;
+    std::atomic<uint64_t> count{0};      // poses appended so far
+    std::atomic<uint64_t> firstSerial{0}; // oldest pose of the current clock
+    double newestTs = 0.0;                // writer only
+};
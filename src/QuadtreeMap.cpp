@@ -3,8 +3,13 @@
 #include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
 #include <unordered_map>
 
+#include "TileStore.hpp"
+
 // ---- Utility time ----
 double ElevationMap::nowSeconds() {
     using clock = std::chrono::steady_clock;
@@ -15,57 +20,451 @@ double ElevationMap::nowSeconds() {
 }
 
 // ---- Tile methods ----
-static inline int childIndexFor(float x, float z, float cx, float cz) {
-    // SW(0): x<cx,z<cz; SE(1): x>=cx,z<cz; NW(2): x<cx,z>=cz; NE(3): x>=cx,z>=cz
-    int xi = (x >= cx) ? 1 : 0;
-    int zi = (z >= cz) ? 1 : 0;
-    // map (xi,zi) -> idx
-    if (xi == 0 && zi == 0) return 0; // SW
-    if (xi == 1 && zi == 0) return 1; // SE
-    if (xi == 0 && zi == 1) return 2; // NW
-    return 3; // NE
-}
-
-QuadNode* Tile::locateLeaf(float x, float z) {
-    if (!root) root = std::make_unique<QuadNode>();
+// Spreads the low 16 bits of v to the even bit positions
+static inline uint32_t spreadBits(uint32_t v) {
+    v &= 0xFFFFu;
+    v = (v | (v << 8)) & 0x00FF00FFu;
+    v = (v | (v << 4)) & 0x0F0F0F0Fu;
+    v = (v | (v << 2)) & 0x33333333u;
+    v = (v | (v << 1)) & 0x55555555u;
+    return v;
+}
+
+// Morton code of a leaf cell (layer coordinates). Its base-4 digits, most significant first,
+// are the child indices on the path from the root: x bit low, z bit high, matching the
+// SW(0), SE(1), NW(2), NE(3) child order.
+static inline uint32_t mortonCode(int lx, int lz) {
+    return spreadBits(static_cast<uint32_t>(lx)) | (spreadBits(static_cast<uint32_t>(lz)) << 1);
+}
+
+// Child of the node at `depth` on the path to the cell with this Morton code
+static inline int childAt(uint32_t code, int leafDepth, int depth) {
+    return static_cast<int>((code >> (2 * (leafDepth - 1 - depth))) & 3u);
+}
+
+// Runs fn with the leaf depth as a compile-time constant for the common tile geometries
+// (16 to 128 leaf cells per edge), so loops over levels unroll and cell index math folds to
+// constant shifts and masks. Other depths run the same code with the runtime value.
+template <typename Fn>
+static inline decltype(auto) dispatchLeafDepth(int leafDepth, Fn&& fn) {
+    switch (leafDepth) {
+    case 4: return fn(std::integral_constant<int, 4>{});
+    case 5: return fn(std::integral_constant<int, 5>{});
+    case 6: return fn(std::integral_constant<int, 6>{});
+    case 7: return fn(std::integral_constant<int, 7>{});
+    default: return fn(leafDepth);
+    }
+}
+
+// Leaf cell (layer coordinates) containing (x, z), clamped to the tile. Every lookup uses this
+// global-cell formula, so a point lands in the same cell whichever path resolves it.
+template <typename LeafDepth>
+static inline void tileLeafCell(const Tile& t, LeafDepth leafDepthC, float x, float z, int* lx, int* lz) {
+    const int side = 1 << static_cast<int>(leafDepthC);
+    const float cellsPerMeter = static_cast<float>(side) / t.size;
+    *lx = std::clamp(floorToInt(x * cellsPerMeter) - t.cellX0, 0, side - 1);
+    *lz = std::clamp(floorToInt(z * cellsPerMeter) - t.cellZ0, 0, side - 1);
+}
+
+QuadNode* Tile::locateLeaf(float x, float z, QuadNode** path, int* pathLen, int splitToDepth) {
+    if (!root) {
+        root = std::make_unique<QuadNode>();
+        recountNodes();
+    }
+    return dispatchLeafDepth(leafDepth(), [&](auto leafDepthC) {
+        return locateLeafAt(leafDepthC, x, z, path, pathLen, splitToDepth);
+    });
+}
+
+template <typename LeafDepth>
+QuadNode* Tile::locateLeafAt(LeafDepth leafDepthC, float x, float z, QuadNode** path, int* pathLen,
+                             int splitToDepth) {
+    const int levels = static_cast<int>(leafDepthC) + 1;
+    if (splitToDepth < 0 || splitToDepth > levels - 1) splitToDepth = levels - 1;
+    int lx, lz;
+    tileLeafCell(*this, leafDepthC, x, z, &lx, &lz);
+    const uint32_t code = mortonCode(lx, lz);
     QuadNode* node = root.get();
-    float cx = originX + size * 0.5f;
-    float cz = originZ + size * 0.5f;
-    float half = size * 0.5f;
-    for (int depth = 0; depth < maxDepth; ++depth) {
+    int len = 0;
+    for (int depth = 0; depth < levels; ++depth) {
+        if (path) path[len++] = node;
+        if (pathLen) *pathLen = len;
         if (node->isLeaf) {
-            // Split if not at max depth
-            if (depth == maxDepth - 1) {
+            // Split until the requested depth
+            if (depth >= splitToDepth) {
                 return node;
             }
             node->isLeaf = false;
+            nodeCount += 4;
+            leafCount += 3;
+            if (node->cell.valid) validLeafCount += 3;
             for (int i = 0; i < 4; ++i) {
                 node->children[i] = std::make_unique<QuadNode>();
                 // Initialize children from parent for continuity
                 node->children[i]->isLeaf = true;
                 node->children[i]->cell = node->cell;
+                node->children[i]->bounds = node->bounds;
             }
         }
-        int idx = childIndexFor(x, z, cx, cz);
-        // Update center for next level
-        half *= 0.5f;
-        cx += (idx == 1 || idx == 3) ? half : -half;
-        cz += (idx >= 2) ? half : -half;
-        node = node->children[idx].get();
+        node = node->children[childAt(code, levels - 1, depth)].get();
     }
     return node;
 }
 
+// Nodes, leaves and valid leaves of a subtree
+static void countSubtree(const QuadNode& top, uint32_t* nodes, uint32_t* leaves, uint32_t* valid) {
+    ScanArena::Scope scratch;
+    ScratchVector<const QuadNode*> stack;
+    stack.reserve(64);
+    stack.push_back(&top);
+    while (!stack.empty()) {
+        const QuadNode* node = stack.back();
+        stack.pop_back();
+        (*nodes)++;
+        if (node->isLeaf) {
+            (*leaves)++;
+            if (node->cell.valid) (*valid)++;
+            continue;
+        }
+        for (int i = 0; i < 4; ++i)
+            if (node->children[i]) stack.push_back(node->children[i].get());
+    }
+}
+
+void Tile::recountNodes() {
+    nodeCount = leafCount = validLeafCount = 0;
+    if (root) countSubtree(*root, &nodeCount, &leafCount, &validLeafCount);
+}
+
+ElevationStats Tile::stats() const {
+    ElevationStats st;
+    st.numTiles = 1;
+    st.numLeaves = leafCount;
+    st.numValidCells = validLeafCount;
+    st.treeBytes = nodeCount * sizeof(QuadNode);
+    st.layerBytes = layers.height.capacity() * sizeof(float) + layers.variance.capacity() * sizeof(float) +
+                    layers.count.capacity() * sizeof(uint16_t) + layers.flags.capacity() + layers.age.capacity();
+    st.traversabilityBytes = (traversability.slope.capacity() + traversability.step.capacity() +
+                              traversability.roughness.capacity()) * sizeof(float) +
+                             traversability.cost.capacity();
+    return st;
+}
+
 static inline void emaUpdate(float& mean, float newVal, float alpha) {
     mean = mean + alpha * (newVal - mean);
 }
 
-void Tile::integratePoint(const LidarPoint& p, double nowTs,
+// Combines child bounds; the mean is the average over observed children (equal areas)
+static HeightBounds combineBounds(const HeightBounds* parts, int count) {
+    HeightBounds b;
+    float sum = 0.0f;
+    int n = 0;
+    for (int i = 0; i < count; ++i) {
+        if (parts[i].empty()) continue;
+        b.minY = std::min(b.minY, parts[i].minY);
+        b.maxY = std::max(b.maxY, parts[i].maxY);
+        sum += parts[i].mean;
+        n++;
+    }
+    b.mean = n > 0 ? sum / n : 0.0f;
+    return b;
+}
+
+static inline void refreshNodeBounds(QuadNode* node) {
+    if (node->isLeaf) {
+        node->bounds = HeightBounds{};
+        if (node->cell.valid) node->bounds = {node->cell.z_mean, node->cell.z_mean, node->cell.z_mean};
+        return;
+    }
+    HeightBounds parts[4];
+    for (int i = 0; i < 4; ++i) {
+        if (node->children[i]) parts[i] = node->children[i]->bounds;
+    }
+    node->bounds = combineBounds(parts, 4);
+}
+
+// Bottom-up refresh along a root-to-leaf path after the leaf cell changed
+static inline void refreshPathBounds(QuadNode** path, int len) {
+    for (int i = len - 1; i >= 0; --i) refreshNodeBounds(path[i]);
+}
+
+static void rebuildNodeBounds(QuadNode* node) {
+    if (!node->isLeaf) {
+        for (int i = 0; i < 4; ++i) {
+            if (node->children[i]) rebuildNodeBounds(node->children[i].get());
+        }
+    }
+    refreshNodeBounds(node);
+}
+
+void Tile::rebuildBounds() {
+    if (root) rebuildNodeBounds(root.get());
+}
+
+static std::unique_ptr<QuadNode> cloneNode(const QuadNode& node) {
+    auto copy = std::make_unique<QuadNode>();
+    copy->isLeaf = node.isLeaf;
+    copy->cell = node.cell;
+    copy->bounds = node.bounds;
+    for (int i = 0; i < 4; ++i) {
+        if (node.children[i]) copy->children[i] = cloneNode(*node.children[i]);
+    }
+    return copy;
+}
+
+Tile Tile::clone() const {
+    Tile t;
+    t.originX = originX;
+    t.originZ = originZ;
+    t.size = size;
+    t.maxDepth = maxDepth;
+    t.cellX0 = cellX0;
+    t.cellZ0 = cellZ0;
+    t.dirty = dirty;
+    t.nodeCount = nodeCount;
+    t.leafCount = leafCount;
+    t.validLeafCount = validLeafCount;
+    if (root) t.root = cloneNode(*root);
+    t.layers = layers;
+    t.traversability = traversability;
+    t.travX0 = travX0; t.travZ0 = travZ0; t.travX1 = travX1; t.travZ1 = travZ1;
+    t.ageBase = ageBase;
+    return t;
+}
+
+void CellLayers::reset(int sideCells) {
+    side = sideCells;
+    size_t n = static_cast<size_t>(side) * static_cast<size_t>(side);
+    height.assign(n, 0.0f);
+    variance.assign(n, 0.0f);
+    count.assign(n, 0);
+    flags.assign(n, 0);
+    age.assign(n, 0);
+}
+
+void TraversabilityLayers::reset(int sideCells) {
+    side = sideCells;
+    size_t n = static_cast<size_t>(side) * static_cast<size_t>(side);
+    slope.assign(n, 0.0f);
+    step.assign(n, 0.0f);
+    roughness.assign(n, 0.0f);
+    cost.assign(n, kTraversabilityUnknown);
+}
+
+void Tile::markTraversabilityStale(int x0, int z0, int x1, int z1) {
+    if (!traversabilityStale()) {
+        travX0 = x0; travZ0 = z0; travX1 = x1; travZ1 = z1;
+        return;
+    }
+    travX0 = std::min(travX0, x0); travZ0 = std::min(travZ0, z0);
+    travX1 = std::max(travX1, x1); travZ1 = std::max(travZ1, z1);
+}
+
+void Tile::writeLayerBlock(const ElevCell& c, int bx, int bz, int block) {
+    const int side = layers.side;
+    // The block and its 8-neighbourhood derive their traversability from these heights
+    markTraversabilityStale(bx - 1, bz - 1, bx + block, bz + block);
+    uint16_t n = c.valid ? c.n : 0;
+    uint8_t f = c.valid ? static_cast<uint8_t>(c.flags | ELEV_VALID) : 0;
+    for (int j = bz; j < bz + block; ++j) {
+        size_t row = static_cast<size_t>(j) * side;
+        for (int i = bx; i < bx + block; ++i) {
+            layers.height[row + i] = c.z_mean;
+            layers.variance[row + i] = c.z_var;
+            layers.count[row + i] = n;
+            layers.flags[row + i] = f;
+            layers.age[row + i] = c.age;
+        }
+    }
+}
+
+void Tile::refreshAge(ElevCell& c, const CellAging* aging) {
+    if (!aging || !aging->enabled) return;
+    if (aging->epoch - ageBase >= 128) rebaseAges(*aging);
+    if (c.valid) c.n = aging->decay(c.n, aging->epoch - cellEpoch(c.age));
+    c.age = static_cast<uint8_t>(aging->epoch);
+}
+
+void Tile::rebaseAges(const CellAging& aging) {
+    if (root) {
+        std::vector<QuadNode*> stack{root.get()};
+        while (!stack.empty()) {
+            QuadNode* node = stack.back();
+            stack.pop_back();
+            ElevCell& c = node->cell;
+            const uint32_t since = cellEpoch(c.age);
+            if (node->isLeaf && c.valid && aging.epoch > since) c.n = aging.decay(c.n, aging.epoch - since);
+            c.age = static_cast<uint8_t>(aging.epoch);
+            for (int i = 0; i < 4; ++i)
+                if (node->children[i]) stack.push_back(node->children[i].get());
+        }
+    }
+    ageBase = aging.epoch;
+    rebuildLayers();
+}
+
+void Tile::leafCellOf(float x, float z, int* lx, int* lz) const {
+    tileLeafCell(*this, leafDepth(), x, z, lx, lz);
+}
+
+void Tile::cellChanged(QuadNode** path, int pathLen, float x, float z) {
+    refreshPathBounds(path, pathLen);
+    if (layers.side == 0 || pathLen == 0) return;
+    // A leaf above the finest level covers a block of layer cells
+    int block = layers.side >> std::min(pathLen - 1, leafDepth());
+    int lx, lz;
+    leafCellOf(x, z, &lx, &lz);
+    writeLayerBlock(path[pathLen - 1]->cell, lx & ~(block - 1), lz & ~(block - 1), block);
+}
+
+void Tile::rebuildLayers() {
+    layers.reset(1 << leafDepth());
+    if (!root) return;
+    struct Block { const QuadNode* node; int bx, bz, block; };
+    std::vector<Block> stack{{root.get(), 0, 0, layers.side}};
+    while (!stack.empty()) {
+        Block b = stack.back();
+        stack.pop_back();
+        if (b.node->isLeaf || b.block == 1) {
+            writeLayerBlock(b.node->cell, b.bx, b.bz, b.block);
+            continue;
+        }
+        int h = b.block / 2;
+        const int ox[4] = {0, h, 0, h};
+        const int oz[4] = {0, 0, h, h};
+        for (int i = 0; i < 4; ++i)
+            if (b.node->children[i]) stack.push_back({b.node->children[i].get(), b.bx + ox[i], b.bz + oz[i], h});
+    }
+}
+
+QuadNode* Tile::splitLeafToward(QuadNode* leaf, float x, float z, QuadNode** path, int* pathLen) {
+    const int depth = *pathLen - 1;
+    // Children start from the parent's height but must earn their own confidence
+    ElevCell seed = leaf->cell;
+    seed.n = std::min<uint16_t>(seed.n, 1);
+    seed.z_var = 0.0f;
+    seed.disagreeHits = 0;
+    leaf->isLeaf = false;
+    nodeCount += 4;
+    leafCount += 3;
+    if (seed.valid) validLeafCount += 3;
+    for (int i = 0; i < 4; ++i) {
+        leaf->children[i] = std::make_unique<QuadNode>();
+        leaf->children[i]->cell = seed;
+        leaf->children[i]->bounds = leaf->bounds;
+    }
+    int lx, lz;
+    leafCellOf(x, z, &lx, &lz);
+    if (layers.side > 0) {
+        int block = layers.side >> depth;
+        writeLayerBlock(seed, lx & ~(block - 1), lz & ~(block - 1), block);
+    }
+    QuadNode* child = leaf->children[childAt(mortonCode(lx, lz), leafDepth(), depth)].get();
+    path[(*pathLen)++] = child;
+    return child;
+}
+
+QuadNode* Tile::nodeAtDepth(float x, float z, int depth, QuadNode** path, int* pathLen) {
+    if (!root) {
+        root = std::make_unique<QuadNode>();
+        recountNodes();
+    }
+    depth = std::clamp(depth, 0, leafDepth());
+    int lx, lz;
+    leafCellOf(x, z, &lx, &lz);
+    const uint32_t code = mortonCode(lx, lz);
+    QuadNode* node = root.get();
+    int len = 0;
+    for (int d = 0;; ++d) {
+        path[len++] = node;
+        if (d == depth) break;
+        if (node->isLeaf) {
+            node->isLeaf = false;
+            nodeCount += 4;
+            leafCount += 3;
+            if (node->cell.valid) validLeafCount += 3;
+            for (int i = 0; i < 4; ++i) {
+                node->children[i] = std::make_unique<QuadNode>();
+                node->children[i]->cell = node->cell;
+                node->children[i]->bounds = node->bounds;
+            }
+        }
+        node = node->children[childAt(code, leafDepth(), d)].get();
+    }
+    if (!node->isLeaf) {
+        // Finer cells below are replaced by this one; judge the change against their mean
+        uint32_t nodes = 0, leaves = 0, valid = 0;
+        countSubtree(*node, &nodes, &leaves, &valid);
+        nodeCount -= nodes - 1;
+        leafCount -= leaves - 1;
+        validLeafCount -= valid;
+        node->cell.valid = !node->bounds.empty();
+        if (node->cell.valid) validLeafCount++;
+        node->cell.prev_z_mean = node->bounds.mean;
+        for (int i = 0; i < 4; ++i) node->children[i].reset();
+        node->isLeaf = true;
+        dirty = true;
+    }
+    *pathLen = len;
+    return node;
+}
+
+bool Tile::assignCell(float x, float z, int depth, float y, float variance, uint16_t n,
+                      float tauUpload, float tauReplace, CellChange* change,
+                      const CellAging* aging) {
+    QuadNode* path[32];
+    int pathLen = 0;
+    QuadNode* node = nodeAtDepth(x, z, depth, path, &pathLen);
+    ElevCell& c = node->cell;
+    refreshAge(c, aging);
+    const float oldY = c.valid ? c.prev_z_mean : y;
+    const float moved = std::fabs(y - oldY);
+    uint8_t kind = 0;
+    if (!c.valid) kind = CHANGE_APPEARED;
+    else if (moved >= tauReplace) kind = CHANGE_REPLACED;
+    else if (moved > tauUpload) kind = CHANGE_DRIFTED;
+    if (!c.valid) validLeafCount++;
+    c.z_mean = y;
+    c.z_var = variance;
+    c.n = n;
+    c.disagreeHits = 0;
+    c.valid = true;
+    c.flags |= ELEV_VALID;
+    if (kind != 0) {
+        c.prev_z_mean = y;
+        c.flags |= ELEV_DIRTY;
+        if (kind != CHANGE_DRIFTED) c.flags |= ELEV_CHANGED;
+        dirty = true;
+    }
+    cellChanged(path, pathLen, x, z);
+    if (kind == 0) return false;
+    if (change) {
+        leafCellOf(x, z, &change->cellX, &change->cellZ);
+        change->oldY = oldY;
+        change->newY = y;
+        change->kind = kind;
+    }
+    return true;
+}
+
+bool Tile::integratePoint(const LidarPoint& p, double nowTs,
                           float tauAccept, float tauReplace,
                           int K, int Nsat, int Nconf, float tauUpload,
-                          float disagreeWindowSeconds) {
-    QuadNode* leaf = locateLeaf(p.x, p.z);
+                          float disagreeWindowSeconds, CellChange* change,
+                          const RefinePolicy* refine, const CellAging* aging) {
+    QuadNode* path[32];
+    int pathLen = 0;
+    QuadNode* leaf = locateLeaf(p.x, p.z, path, &pathLen, refine ? refine->minDepth : -1);
+    if (refine && pathLen - 1 < leafDepth()) {
+        const ElevCell& lc = leaf->cell;
+        bool rough = lc.z_var > refine->splitVariance || std::fabs(p.y - lc.z_mean) > refine->splitResidual;
+        if (lc.valid && lc.n >= refine->splitSamples && rough) leaf = splitLeafToward(leaf, p.x, p.z, path, &pathLen);
+    }
     ElevCell& c = leaf->cell;
+    // Confidence lost while unobserved is settled before the sample is weighed
+    refreshAge(c, aging);
+    const float oldY = c.prev_z_mean;
+    uint8_t kind = 0;
     if (!c.valid) {
         c.z_mean = p.y;
         c.prev_z_mean = c.z_mean;
@@ -74,8 +473,16 @@ void Tile::integratePoint(const LidarPoint& p, double nowTs,
         c.disagreeHits = 0;
         c.flags |= (ELEV_VALID | ELEV_DIRTY | ELEV_CHANGED);
         c.valid = true;
+        validLeafCount++;
         dirty = true;
-        return;
+        cellChanged(path, pathLen, p.x, p.z);
+        if (change) {
+            leafCellOf(p.x, p.z, &change->cellX, &change->cellZ);
+            change->oldY = c.z_mean;
+            change->newY = c.z_mean;
+            change->kind = CHANGE_APPEARED;
+        }
+        return true;
     }
     float dz = std::fabs(p.y - c.z_mean);
     if (dz <= tauAccept) {
@@ -92,6 +499,7 @@ void Tile::integratePoint(const LidarPoint& p, double nowTs,
             c.prev_z_mean = c.z_mean;
             c.flags |= ELEV_DIRTY;
             dirty = true;
+            kind = CHANGE_DRIFTED;
         }
     } else if (dz >= tauReplace) {
         // Within time window?
@@ -102,6 +510,7 @@ void Tile::integratePoint(const LidarPoint& p, double nowTs,
         }
         c.lastDisagreeTs = nowTs;
         if (c.n < Nconf || c.disagreeHits >= K) {
+            kind = CHANGE_REPLACED;
             c.z_mean = p.y;
             c.prev_z_mean = c.z_mean;
             c.z_var = 0.0f;
@@ -118,58 +527,229 @@ void Tile::integratePoint(const LidarPoint& p, double nowTs,
             c.prev_z_mean = c.z_mean;
             c.flags |= ELEV_DIRTY;
             dirty = true;
+            kind = CHANGE_DRIFTED;
         }
         // decay disagreement if too old
         if (nowTs - c.lastDisagreeTs > disagreeWindowSeconds) c.disagreeHits = 0;
     }
+    cellChanged(path, pathLen, p.x, p.z);
+    if (kind == 0) return false;
+    if (change) {
+        leafCellOf(p.x, p.z, &change->cellX, &change->cellZ);
+        change->oldY = oldY;
+        change->newY = c.z_mean;
+        change->kind = kind;
+    }
+    return true;
 }
 
-static float sampleLeafHeight(const QuadNode* node) {
+static inline float sampleNodeHeight(const QuadNode* node) {
     if (!node) return 0.0f;
     if (node->isLeaf) return node->cell.valid ? node->cell.z_mean : 0.0f;
-    // average children
-    float sum = 0.0f; int cnt = 0;
-    for (int i = 0; i < 4; ++i) {
-        if (node->children[i]) { sum += sampleLeafHeight(node->children[i].get()); cnt++; }
-    }
-    return (cnt > 0) ? (sum / cnt) : 0.0f;
+    // Interior node: subtree mean from the maintained bounds
+    return node->bounds.empty() ? 0.0f : node->bounds.mean;
 }
 
 void Tile::buildHeightGrid(int gridNVertices, std::vector<float>& outHeights) const {
-    outHeights.resize(static_cast<size_t>(gridNVertices) * static_cast<size_t>(gridNVertices));
+    buildHeightGridLod(gridNVertices, 0, outHeights);
+}
+
+// Walks from the root toward leaf cell (lx, lz) until a leaf or stopDepth
+template <typename LeafDepth>
+static inline const QuadNode* descendToward(const Tile& t, LeafDepth leafDepthC, int lx, int lz, int stopDepth) {
+    const uint32_t code = mortonCode(lx, lz);
+    const QuadNode* node = t.root.get();
+    for (int depth = 0; depth < static_cast<int>(leafDepthC); ++depth) {
+        if (depth >= stopDepth || !node || node->isLeaf) break;
+        node = node->children[childAt(code, static_cast<int>(leafDepthC), depth)].get();
+    }
+    return node;
+}
+
+void Tile::buildHeightGridLod(int gridNVertices, int lod, std::vector<float>& outHeights) const {
+    int n = ((gridNVertices - 1) >> lod) + 1;
+    outHeights.resize(static_cast<size_t>(n) * static_cast<size_t>(n));
     if (!root) {
         std::fill(outHeights.begin(), outHeights.end(), 0.0f);
         return;
     }
-    float step = size / static_cast<float>(gridNVertices - 1);
-    for (int j = 0; j < gridNVertices; ++j) {
-        for (int i = 0; i < gridNVertices; ++i) {
-            float x = originX + i * step;
-            float z = originZ + j * step;
-            // Traverse to leaf
-            const QuadNode* node = root.get();
-            float cx = originX + size * 0.5f;
-            float cz = originZ + size * 0.5f;
-            float half = size * 0.5f;
-            for (int depth = 0; depth < maxDepth - 1 && node && !node->isLeaf; ++depth) {
-                int idx = childIndexFor(x, z, cx, cz);
-                half *= 0.5f;
-                cx += (idx == 1 || idx == 3) ? half : -half;
-                cz += (idx >= 2) ? half : -half;
-                node = node->children[idx].get();
+    int stopDepth = std::max(0, maxDepth - 1 - lod);
+    dispatchLeafDepth(leafDepth(), [&](auto leafDepthC) {
+        // Vertex i sits at i * side / (n - 1) leaf cells; one on a cell boundary samples the
+        // cell above it, the last row and column the final cell
+        const int side = 1 << static_cast<int>(leafDepthC);
+        for (int j = 0; j < n; ++j) {
+            const int lz = std::min(j * side / (n - 1), side - 1);
+            for (int i = 0; i < n; ++i) {
+                const int lx = std::min(i * side / (n - 1), side - 1);
+                // Traverse to leaf (or to the LOD depth)
+                const QuadNode* node = descendToward(*this, leafDepthC, lx, lz, stopDepth);
+                outHeights[j * n + i] = sampleNodeHeight(node);
             }
-            float y = node ? (node->isLeaf ? (node->cell.valid ? node->cell.z_mean : 0.0f) : sampleLeafHeight(node)) : 0.0f;
-            outHeights[j * gridNVertices + i] = y;
         }
+    });
+}
+
+// ---- Tile serialization ----
+namespace {
+enum NodeTag : uint8_t {
+    TAG_INTERNAL = 0,
+    TAG_EMPTY_LEAF = 1, // leaf with a default-constructed cell
+    TAG_LEAF = 2,
+};
+
+constexpr size_t kPackedCellBytes = 4 + 4 + 2 + 1 + 1 + 1 + 4 + 8 + 1;
+
+template <typename T>
+inline void put(uint8_t*& p, const T& v) { std::memcpy(p, &v, sizeof(T)); p += sizeof(T); }
+template <typename T>
+inline void get(const uint8_t*& p, T& v) { std::memcpy(&v, p, sizeof(T)); p += sizeof(T); }
+
+bool isDefaultCell(const ElevCell& c) {
+    return !c.valid && c.n == 0 && c.flags == 0 && c.z_mean == 0.0f && c.z_var == 0.0f &&
+           c.disagreeHits == 0 && c.age == 0 && c.prev_z_mean == 0.0f && c.lastDisagreeTs == 0.0;
+}
+
+void serializeNode(const QuadNode* node, std::vector<uint8_t>& out) {
+    if (!node->isLeaf) {
+        out.push_back(TAG_INTERNAL);
+        for (int i = 0; i < 4; ++i) serializeNode(node->children[i].get(), out);
+        return;
+    }
+    const ElevCell& c = node->cell;
+    if (isDefaultCell(c)) {
+        out.push_back(TAG_EMPTY_LEAF);
+        return;
     }
+    size_t at = out.size();
+    out.resize(at + 1 + kPackedCellBytes);
+    uint8_t* p = out.data() + at;
+    *p++ = TAG_LEAF;
+    put(p, c.z_mean); put(p, c.z_var); put(p, c.n); put(p, c.disagreeHits);
+    put(p, c.age); put(p, c.flags); put(p, c.prev_z_mean); put(p, c.lastDisagreeTs);
+    uint8_t valid = c.valid ? 1 : 0;
+    put(p, valid);
+}
+
+bool deserializeNode(QuadNode* node, const uint8_t*& p, const uint8_t* end, int depthLeft) {
+    if (p >= end) return false;
+    uint8_t tag = *p++;
+    if (tag == TAG_INTERNAL) {
+        if (depthLeft <= 0) return false;
+        node->isLeaf = false;
+        for (int i = 0; i < 4; ++i) {
+            node->children[i] = std::make_unique<QuadNode>();
+            if (!deserializeNode(node->children[i].get(), p, end, depthLeft - 1)) return false;
+        }
+        return true;
+    }
+    node->isLeaf = true;
+    if (tag == TAG_EMPTY_LEAF) return true;
+    if (tag != TAG_LEAF || static_cast<size_t>(end - p) < kPackedCellBytes) return false;
+    ElevCell& c = node->cell;
+    get(p, c.z_mean); get(p, c.z_var); get(p, c.n); get(p, c.disagreeHits);
+    get(p, c.age); get(p, c.flags); get(p, c.prev_z_mean); get(p, c.lastDisagreeTs);
+    uint8_t valid = 0;
+    get(p, valid);
+    c.valid = valid != 0;
+    return true;
+}
+}
+
+void Tile::serialize(std::vector<uint8_t>& out) const {
+    out.clear();
+    if (!root) {
+        out.push_back(TAG_EMPTY_LEAF);
+        return;
+    }
+    serializeNode(root.get(), out);
+}
+
+bool Tile::deserialize(const uint8_t* data, size_t size) {
+    root = std::make_unique<QuadNode>();
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    if (!deserializeNode(root.get(), p, end, maxDepth)) {
+        root = std::make_unique<QuadNode>();
+        recountNodes();
+        rebuildLayers();
+        return false;
+    }
+    rebuildBounds();
+    recountNodes();
+    rebuildLayers();
+    return true;
 }
 
 // ---- ElevationMap ----
-ElevationMap::ElevationMap() {
+// Rover contribution layers (see setRoverLayers)
+namespace {
+constexpr uint8_t kContribPending = 1u << 0; // queued for the next fusion pass
+// Floor on a contribution's variance when weighting, so a few agreeing samples are not exact
+constexpr float kFusionMinVariance = 0.01f;
+}
+
+struct ElevationMap::ContributionTile {
+    struct Cell {
+        float mean = 0.0f;
+        float var = 0.0f;
+        double lastDisagreeTs = 0.0;
+        uint32_t sinceEpoch = 0; // fusion epoch in which the current surface was first seen
+        uint32_t lastEpoch = 0;  // and last seen
+        uint32_t ageEpoch = 0;   // aging epoch of the last update (see CellAging)
+        uint16_t n = 0;          // 0 = nothing observed (or dropped as stale)
+        uint8_t disagreeHits = 0;
+        uint8_t flags = 0;
+    };
+    std::vector<Cell> cells; // side x side, z-major
+    size_t bytes() const { return sizeof(ContributionTile) + cells.capacity() * sizeof(Cell); }
+};
+
+struct ElevationMap::RoverLayer {
+    std::string roverId;
+    uint16_t changeRover = 0; // ChangeEvent::rover of the changes it fuses
+    std::map<TileKey, std::unique_ptr<ContributionTile>> tiles;
+    std::vector<std::pair<TileKey, uint32_t>> pending; // cells touched since the last fusion
+    size_t tileBytes = 0; // of `tiles`, for getStats
+    size_t allocatedBytes = 0; // running total of tileBytes growth
+    // Per-scan scratch, one set per layer so layers can integrate concurrently
+    ScanBins bins;
+    std::vector<std::pair<uint64_t, uint32_t>> order;
+    std::vector<float> ys;
+};
+
+ElevationMap::ElevationMap() : pyramid(kPyramidLevels) {
     // Tuned for noisier input (sigma ~0.5 m): wider acceptance and replacement, higher confirmation
     setParameters(32.0f, 0.25f, 0.7f, 1.6f, 8, 60, 12, 0.15f, 2.0f);
 }
 
+ElevationMap::~ElevationMap() = default;
+
+std::shared_ptr<const ElevationMap> ElevationMap::snapshot() const {
+    auto snap = std::make_shared<ElevationMap>();
+    snap->tileSize = tileSize;
+    snap->baseCellRes = baseCellRes;
+    snap->maxDepth = maxDepth;
+    snap->tauAccept = tauAccept;
+    snap->tauReplace = tauReplace;
+    snap->K = K;
+    snap->Nsat = Nsat;
+    snap->Nconf = Nconf;
+    snap->tauUpload = tauUpload;
+    snap->disagreeWindow = disagreeWindow;
+    snap->gridNVertices = gridNVertices;
+    snap->travPolicy = travPolicy;
+    snap->agingEpochSeconds = agingEpochSeconds;
+    // O(1): both share their buckets; the writer copies a bucket, and a tile, before changing it
+    snap->tiles = tiles;
+    snap->totals = getStats();
+    snap->pyramid = pyramid;
+    // Spilled tiles stay readable through the shared store (see copyTileHeights)
+    snap->store = store;
+    snap->residentStored = residentStored;
+    return snap;
+}
+
 void ElevationMap::setParameters(float tileSizeMeters,
                                  float baseCellResolutionMeters,
                                  float tauAcceptMeters,
@@ -197,92 +777,629 @@ void ElevationMap::setParameters(float tileSizeMeters,
     maxDepth = power; // depth produces 2^power cells along edge
     int gridN = (1 << power) + 1;
     gridNVertices = gridN;
+    // Rover layers keep the ~1 m cells integrateScan aggregates at, as whole quadtree levels
+    const int leafDepth = std::max(maxDepth - 1, 0);
+    const float aggregateCell = std::max(baseCellRes, 1.0f);
+    contribDepth = 0;
+    while (contribDepth < leafDepth && tileSize / static_cast<float>(1 << (contribDepth + 1)) >= aggregateCell * 0.999f)
+        contribDepth++;
+}
+
+void ElevationMap::setAging(float halfLifeSeconds) {
+    agingEpochSeconds = halfLifeSeconds > 0.0f ? halfLifeSeconds / CellAging::kEpochsPerHalfLife : 0.0f;
+}
+
+CellAging ElevationMap::agingNow() const {
+    CellAging a;
+    a.enabled = agingEpochSeconds > 0.0f;
+    if (a.enabled) a.epoch = static_cast<uint32_t>(nowSeconds() / agingEpochSeconds);
+    return a;
+}
+
+uint16_t ElevationMap::agedCount(const Tile& t, uint16_t n, uint8_t age, const CellAging& aging) const {
+    if (!aging.enabled) return n;
+    const uint32_t since = t.cellEpoch(age);
+    return aging.epoch > since ? aging.decay(n, aging.epoch - since) : n;
 }
 
 Tile& ElevationMap::getOrCreateTile(int tx, int tz) {
     TileKey key{tx, tz};
-    auto it = tiles.find(key);
-    if (it != tiles.end()) return it->second;
+    if (std::shared_ptr<Tile>* slot = tiles.findWritable(key)) {
+        // Copy-on-write: a snapshot still holds this tile, so change a private copy
+        if (slot->use_count() > 1) {
+            *slot = std::make_shared<Tile>((*slot)->clone());
+            const ElevationStats st = (*slot)->stats();
+            totals.allocatedBytes += st.treeBytes + st.layerBytes + st.traversabilityBytes;
+        }
+        return **slot;
+    }
     float ox = tx * tileSize;
     float oz = tz * tileSize;
     Tile t(ox, oz, tileSize, maxDepth);
-    auto [insIt, _] = tiles.emplace(key, std::move(t));
-    return insIt->second;
+    const CellAging aging = agingNow();
+    t.ageBase = aging.epoch;
+    // Fault a spilled tile back in; on a failed read start over rather than losing the key
+    if (store && store->contains(key)) {
+        if (store->load(key, t)) updatePyramid(key, t.bounds());
+        else t = Tile(ox, oz, tileSize, maxDepth);
+        auto spilled = spilledAgeBase.find(key);
+        if (spilled != spilledAgeBase.end()) {
+            t.ageBase = spilled->second;
+            spilledAgeBase.erase(spilled);
+        } else if (aging.enabled) {
+            // Ages saved by an earlier run mean nothing on this clock; its cells start fresh
+            CellAging restamp = aging;
+            restamp.enabled = false;
+            t.rebaseAges(restamp);
+        }
+    }
+    // A tile spilled before its upload still needs one
+    if (t.dirty) markForUpload(key);
+    t.dirty = false;
+    if (store && store->contains(key) && storedResident.insert(key).second) residentStored++;
+    std::shared_ptr<Tile>& slot = tiles[key];
+    slot = std::make_shared<Tile>(std::move(t));
+    accountTile(ElevationStats{}, slot->stats());
+    return *slot;
 }
 
-void ElevationMap::integrateScan(const std::vector<LidarPoint>& points, double nowTs) {
+void ElevationMap::accountTile(const ElevationStats& before, const ElevationStats& after) {
+    // Unsigned wrap-around cancels out: the totals never drop below what the tiles hold
+    totals.numTiles += after.numTiles - before.numTiles;
+    totals.numLeaves += after.numLeaves - before.numLeaves;
+    totals.numValidCells += after.numValidCells - before.numValidCells;
+    totals.treeBytes += after.treeBytes - before.treeBytes;
+    totals.layerBytes += after.layerBytes - before.layerBytes;
+    totals.traversabilityBytes += after.traversabilityBytes - before.traversabilityBytes;
+    // Growth only; storage is rarely given back before the tile goes
+    const size_t grownFrom = before.treeBytes + before.layerBytes + before.traversabilityBytes;
+    const size_t grownTo = after.treeBytes + after.layerBytes + after.traversabilityBytes;
+    if (grownTo > grownFrom) totals.allocatedBytes += grownTo - grownFrom;
+}
+
+bool ElevationMap::enableTileStore(const std::string& path, size_t maxResident,
+                                   bool restoreExisting, bool compress) {
+    auto s = std::make_unique<TileStore>();
+    if (!s->open(path, tileSize, maxDepth, restoreExisting)) return false;
+    s->setCompression(compress);
+    restoredPending.clear();
+    if (restoreExisting) {
+        // Bounds from the record headers stand in for the tiles until they fault in, so
+        // pyramid queries see the restored terrain right away
+        for (const auto& kb : s->storedBounds()) {
+            if (tiles.find(kb.first) != tiles.end()) continue;
+            restoredPending.push_back(kb.first);
+            if (!kb.second.empty()) updatePyramid(kb.first, kb.second);
+        }
+    }
+    storedResident.clear();
+    for (const auto& kv : tiles) {
+        if (s->contains(kv.first)) storedResident.insert(kv.first);
+    }
+    residentStored = storedResident.size();
+    store = std::move(s);
+    maxResidentTiles = maxResident;
+    return true;
+}
+
+void ElevationMap::emitRestored(size_t maxTiles, std::vector<TileUpdate>& updates) {
+    // Restored tiles are loaded a batch at a time and handed out immediately, so eviction
+    // can drop them again before they were ever uploaded without losing them on screen
+    while (maxTiles > 0 && !restoredPending.empty()) {
+        const TileKey key = restoredPending.back();
+        restoredPending.pop_back();
+        Tile& t = getOrCreateTile(key.tx, key.tz);
+        TileUpdate up;
+        up.key = key;
+        up.tileSize = tileSize;
+        t.buildHeightGrid(gridNVertices, up.heights);
+        updates.push_back(std::move(up));
+        if (uploadPending.erase(key)) totals.numDirtyTiles--;
+        maxTiles--;
+    }
+}
+
+size_t ElevationMap::checkpointDirtyTiles(size_t maxTiles) {
+    if (!store) return 0;
+    size_t written = 0;
+    // Only resident tiles are pending; evictTile saves a tile as it drops it
+    for (auto it = checkpointPending.begin(); it != checkpointPending.end() && written < maxTiles;) {
+        const TileKey key = *it;
+        it = checkpointPending.erase(it);
+        auto t = tiles.find(key);
+        if (t == tiles.end()) continue;
+        store->save(key, *t->second, uploadPending.count(key) != 0);
+        if (storedResident.insert(key).second) residentStored++;
+        written++;
+    }
+    return written;
+}
+
+void ElevationMap::flushTileStore() {
+    if (!store) return;
+    checkpointDirtyTiles(std::numeric_limits<size_t>::max());
+    store->flush();
+}
+
+std::vector<TileKey> ElevationMap::residentKeys() const {
+    std::vector<TileKey> keys;
+    keys.reserve(tiles.size());
+    for (const auto& kv : tiles) keys.push_back(kv.first);
+    return keys;
+}
+
+std::vector<TileKey> ElevationMap::tileKeys() const {
+    std::vector<TileKey> keys;
+    if (store) keys = store->keys();
+    const size_t spilled = keys.size();
+    // Both lists sorted; tiles the store also holds appear twice
+    for (const auto& kv : tiles) keys.push_back(kv.first);
+    std::sort(keys.begin() + static_cast<long>(spilled), keys.end());
+    std::inplace_merge(keys.begin(), keys.begin() + static_cast<long>(spilled), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end(), [](const TileKey& a, const TileKey& b) {
+                   return a.tx == b.tx && a.tz == b.tz;
+               }), keys.end());
+    return keys;
+}
+
+bool ElevationMap::copyTileHeights(const TileKey& key, std::vector<float>& out) const {
+    const int side = getTileCells();
+    const Tile* tile = nullptr;
+    Tile loaded;
+    auto it = tiles.find(key);
+    if (it != tiles.end()) tile = it->second.get();
+    else if (store && store->load(key, loaded)) tile = &loaded;
+    else return false;
+    const size_t cells = static_cast<size_t>(side) * static_cast<size_t>(side);
+    out.assign(cells, std::numeric_limits<float>::quiet_NaN());
+    const CellLayers& l = tile->layers;
+    if (l.side != side) return true;
+    for (size_t i = 0; i < cells; ++i) {
+        if (l.flags[i] & ELEV_VALID) out[i] = l.height[i];
+    }
+    return true;
+}
+
+void ElevationMap::evictDistantTiles(const std::vector<std::pair<float, float>>& anchorsXZ) {
+    if (!store) return;
+    const bool overCount = maxResidentTiles > 0 && tiles.size() > maxResidentTiles;
+    const bool overBytes = memoryBudget > 0 && getStats().residentBytes() > memoryBudget;
+    if (!overCount && !overBytes) return;
+    // Evict down to low-water marks so we do not spill a tile or two every frame
+    const size_t target = overCount ? maxResidentTiles - maxResidentTiles / 8 : tiles.size();
+    const size_t byteTarget = memoryBudget - memoryBudget / 8;
+    std::vector<std::pair<float, TileKey>> byDistance;
+    byDistance.reserve(tiles.size());
+    for (const auto& kv : tiles) {
+        float cx = (kv.first.tx + 0.5f) * tileSize;
+        float cz = (kv.first.tz + 0.5f) * tileSize;
+        float best = std::numeric_limits<float>::infinity();
+        for (const auto& a : anchorsXZ) {
+            float dx = cx - a.first, dz = cz - a.second;
+            best = std::min(best, dx * dx + dz * dz);
+        }
+        byDistance.emplace_back(best, kv.first);
+    }
+    auto farthestFirst = [](const auto& a, const auto& b) { return a.first > b.first; };
+    if (overBytes) {
+        // How many tiles the bytes need is only known while evicting
+        std::sort(byDistance.begin(), byDistance.end(), farthestFirst);
+    } else {
+        std::nth_element(byDistance.begin(), byDistance.begin() + static_cast<long>(tiles.size() - target),
+                         byDistance.end(), farthestFirst);
+    }
+    for (const auto& entry : byDistance) {
+        const bool countOk = tiles.size() <= target;
+        if (countOk && (!overBytes || getStats().residentBytes() <= byteTarget)) break;
+        evictTile(entry.second);
+    }
+}
+
+void ElevationMap::evictTile(const TileKey& key) {
+    const Tile& tile = *tiles.at(key);
+    // The queued copy stays readable until the writer has it on disk
+    store->save(key, tile, uploadPending.count(key) != 0);
+    checkpointPending.erase(key);
+    if (uploadPending.erase(key)) totals.numDirtyTiles--;
+    // Cell ages are only meaningful against the tile's base epoch, which the store does not keep
+    if (agingEpochSeconds > 0.0f) spilledAgeBase[key] = tile.ageBase;
+    // Rover contributions go with the tile; its saved heights become the baseline when it returns
+    auto base = fusionBaseline.find(key);
+    if (base != fusionBaseline.end()) {
+        if (base->second) baselineBytes -= base->second->bytes();
+        fusionBaseline.erase(base);
+    }
+    for (auto& layer : roverLayers) {
+        auto lt = layer->tiles.find(key);
+        if (lt == layer->tiles.end()) continue;
+        layer->tileBytes -= lt->second->bytes();
+        layer->tiles.erase(lt);
+    }
+    accountTile(tile.stats(), ElevationStats{});
+    // No longer resident; the store's copy now counts as spilled
+    if (storedResident.erase(key)) residentStored--;
+    tiles.erase(key);
+}
+
+void ElevationMap::requestTileUploads(const std::vector<TileKey>& keys) {
+    for (const TileKey& key : keys) {
+        auto it = tiles.find(key);
+        if (it == tiles.end()) {
+            // Loaded and handed out by emitRestored, like the tiles of a restored map
+            if (store && store->contains(key) &&
+                std::none_of(restoredPending.begin(), restoredPending.end(), [&](const TileKey& k) {
+                    return k.tx == key.tx && k.tz == key.tz;
+                }))
+                restoredPending.push_back(key);
+            continue;
+        }
+        markForUpload(key);
+    }
+}
+
+void ElevationMap::markForUpload(const TileKey& key) {
+    if (uploadPending.insert(key).second) totals.numDirtyTiles++;
+}
+
+void ElevationMap::takeTileChanges(const TileKey& key, Tile& tile) {
+    if (!tile.dirty) return;
+    tile.dirty = false;
+    checkpointPending.insert(key);
+    markForUpload(key);
+}
+
+void ElevationMap::integrateScan(const std::vector<LidarPoint>& points, double nowTs,
+                                 const std::string& roverId) {
+    ScanArena::Scope scratch;
+    if (roverLayersEnabled) {
+        int layer = roverLayerIndex(roverId);
+        if (layer < 0) layer = addRoverLayer(roverId);
+        accumulateScan(layer, points, nowTs);
+        fuseRoverLayers(nowTs);
+        return;
+    }
+    const CellAging aging = agingNow();
+    const uint16_t changeRover = changeRoverId(roverId);
     // Robustify per-scan by spatially grouping points at base cell resolution
-    struct Group {
-        float xSum = 0.0f;
-        float zSum = 0.0f;
-        std::vector<float> ys;
-        int count = 0;
-    };
-    std::unordered_map<long long, Group> groups;
-    groups.reserve(points.size() / 4 + 8);
     const float cell = std::max(baseCellRes, 1.0f); // aggregate at ~1m cells for robustness
-    for (const auto& p : points) {
-        int ix = static_cast<int>(std::floor(p.x / cell));
-        int iz = static_cast<int>(std::floor(p.z / cell));
-        long long key = (static_cast<long long>(ix) << 32) ^ (static_cast<unsigned long long>(iz) & 0xffffffffull);
-        auto& g = groups[key];
-        g.xSum += p.x;
-        g.zSum += p.z;
-        g.ys.push_back(p.y);
-        g.count++;
-    }
-    for (const auto& kv : groups) {
-        const Group& g = kv.second;
-        if (g.count == 0) continue;
+    binScanPoints(points.data(), points.size(), cell, tileSize, scanBins);
+    // Group by sorting point indices on the packed cell key; runs are the groups
+    const size_t count = scanBins.size();
+    scanOrder.resize(count);
+    for (size_t i = 0; i < count; ++i) scanOrder[i] = {scanBins.cellKey[i], static_cast<uint32_t>(i)};
+    std::sort(scanOrder.begin(), scanOrder.end());
+    ScratchVector<TileKey> touched;
+    for (size_t run = 0; run < count;) {
+        size_t runEnd = run + 1;
+        while (runEnd < count && scanOrder[runEnd].first == scanOrder[run].first) ++runEnd;
+        float xSum = 0.0f, zSum = 0.0f;
+        scanYs.clear();
+        for (size_t r = run; r < runEnd; ++r) {
+            uint32_t i = scanOrder[r].second;
+            xSum += scanBins.x[i];
+            zSum += scanBins.z[i];
+            scanYs.push_back(scanBins.y[i]);
+        }
         // median Y for robustness against outliers
-        std::vector<float> ys = g.ys;
-        size_t mid = ys.size() / 2;
-        std::nth_element(ys.begin(), ys.begin() + mid, ys.end());
-        float yMed = ys[mid];
-        float xAvg = g.xSum / static_cast<float>(g.count);
-        float zAvg = g.zSum / static_cast<float>(g.count);
-        LidarPoint q{ xAvg, yMed, zAvg };
-        int tx = static_cast<int>(std::floor(q.x / tileSize));
-        int tz = static_cast<int>(std::floor(q.z / tileSize));
+        size_t mid = scanYs.size() / 2;
+        std::nth_element(scanYs.begin(), scanYs.begin() + mid, scanYs.end());
+        float yMed = scanYs[mid];
+        float n = static_cast<float>(runEnd - run);
+        LidarPoint q{ xSum / n, yMed, zSum / n };
+        // The group's points share a cell; with whole-metre tiles cells nest in tiles
+        uint32_t first = scanOrder[run].second;
+        int tx = scanBins.tileX[first];
+        int tz = scanBins.tileZ[first];
+        run = runEnd;
         Tile& tile = getOrCreateTile(tx, tz);
-        tile.integratePoint(q, nowTs, tauAccept, tauReplace, K, Nsat, Nconf, tauUpload, disagreeWindow);
+        const ElevationStats before = tile.stats();
+        CellChange change;
+        if (tile.integratePoint(q, nowTs, tauAccept, tauReplace, K, Nsat, Nconf, tauUpload, disagreeWindow, &change,
+                                adaptiveRefine ? &refinePolicy : nullptr, &aging) &&
+            changeCapacity > 0) {
+            recordChange(TileKey{tx, tz}, change, nowTs, changeRover);
+        }
+        accountTile(before, tile.stats());
+        takeTileChanges(TileKey{tx, tz}, tile);
+        if (touched.empty() || touched.back().tx != tx || touched.back().tz != tz) touched.push_back(TileKey{tx, tz});
     }
+    propagateTileBounds(touched);
+}
+
+void ElevationMap::propagateTileBounds(ScratchVector<TileKey>& touched) {
+    // Propagate changed tile bounds up the pyramid once per tile, not per point
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end(),
+                              [](const TileKey& a, const TileKey& b) { return a.tx == b.tx && a.tz == b.tz; }),
+                  touched.end());
+    for (const TileKey& key : touched) {
+        HeightBounds b = tiles.at(key)->bounds();
+        auto it = pyramid[0].find(key);
+        if (it == pyramid[0].end() || it->second != b) updatePyramid(key, b);
+    }
+}
+
+// ---- Rover contribution layers ----
+int ElevationMap::addRoverLayer(const std::string& roverId) {
+    auto it = roverLayerIds.find(roverId);
+    if (it != roverLayerIds.end()) return it->second;
+    const int index = static_cast<int>(roverLayers.size());
+    auto layer = std::make_unique<RoverLayer>();
+    layer->roverId = roverId;
+    layer->changeRover = changeRoverId(roverId);
+    roverLayers.push_back(std::move(layer));
+    roverLayerIds.emplace(roverId, index);
+    return index;
+}
+
+int ElevationMap::roverLayerIndex(const std::string& roverId) const {
+    auto it = roverLayerIds.find(roverId);
+    return it != roverLayerIds.end() ? it->second : -1;
+}
+
+void ElevationMap::accumulateScan(int layer, const std::vector<LidarPoint>& points, double nowTs) {
+    if (layer < 0 || static_cast<size_t>(layer) >= roverLayers.size()) return;
+    RoverLayer& L = *roverLayers[layer];
+    const int side = 1 << contribDepth;
+    const CellAging aging = agingNow();
+    binScanPoints(points.data(), points.size(), tileSize / static_cast<float>(side), tileSize, L.bins);
+    const size_t count = L.bins.size();
+    L.order.resize(count);
+    for (size_t i = 0; i < count; ++i) L.order[i] = {L.bins.cellKey[i], static_cast<uint32_t>(i)};
+    std::sort(L.order.begin(), L.order.end());
+    ContributionTile* tile = nullptr;
+    TileKey tileKey;
+    for (size_t run = 0; run < count;) {
+        size_t runEnd = run + 1;
+        while (runEnd < count && L.order[runEnd].first == L.order[run].first) ++runEnd;
+        L.ys.clear();
+        for (size_t r = run; r < runEnd; ++r) L.ys.push_back(L.bins.y[L.order[r].second]);
+        // Median, as in integrateScan
+        size_t mid = L.ys.size() / 2;
+        std::nth_element(L.ys.begin(), L.ys.begin() + mid, L.ys.end());
+        const float y = L.ys[mid];
+        const uint32_t first = L.order[run].second;
+        run = runEnd;
+
+        TileKey key{L.bins.tileX[first], L.bins.tileZ[first]};
+        if (!tile || key.tx != tileKey.tx || key.tz != tileKey.tz) {
+            auto& slot = L.tiles[key];
+            if (!slot) {
+                slot = std::make_unique<ContributionTile>();
+                slot->cells.resize(static_cast<size_t>(side) * static_cast<size_t>(side));
+                L.tileBytes += slot->bytes();
+                L.allocatedBytes += slot->bytes();
+            }
+            tile = slot.get();
+            tileKey = key;
+        }
+        int lx = std::clamp(L.bins.cellX[first] - key.tx * side, 0, side - 1);
+        int lz = std::clamp(L.bins.cellZ[first] - key.tz * side, 0, side - 1);
+        const uint32_t idx = static_cast<uint32_t>(lz * side + lx);
+        ContributionTile::Cell& c = tile->cells[idx];
+        if (c.n > 0 && aging.epoch > c.ageEpoch) c.n = aging.decay(c.n, aging.epoch - c.ageEpoch);
+        c.ageEpoch = aging.epoch;
+
+        // The rover's own estimate follows the same accept / replace / gray-zone rules as a map cell
+        if (c.n == 0) {
+            c.mean = y;
+            c.var = 0.0f;
+            c.n = 1;
+            c.disagreeHits = 0;
+            c.sinceEpoch = fuseEpoch;
+        } else {
+            float dz = std::fabs(y - c.mean);
+            if (dz <= tauAccept) {
+                uint16_t nprime = static_cast<uint16_t>(std::min<int>(c.n + 1, Nsat));
+                float delta = y - c.mean;
+                c.mean += delta / std::max<uint16_t>(nprime, 1);
+                c.var = 0.9f * c.var + 0.1f * (delta * delta);
+                c.n = nprime;
+                c.disagreeHits = 0;
+            } else if (dz >= tauReplace) {
+                if (nowTs - c.lastDisagreeTs <= disagreeWindow) {
+                    if (c.disagreeHits < 255) c.disagreeHits++;
+                } else {
+                    c.disagreeHits = 1;
+                }
+                c.lastDisagreeTs = nowTs;
+                if (c.n < Nconf || c.disagreeHits >= K) {
+                    c.mean = y;
+                    c.var = 0.0f;
+                    c.n = 1;
+                    c.disagreeHits = 0;
+                    c.sinceEpoch = fuseEpoch;
+                }
+            } else {
+                emaUpdate(c.mean, y, 0.05f);
+                if (nowTs - c.lastDisagreeTs > disagreeWindow) c.disagreeHits = 0;
+            }
+        }
+        c.lastEpoch = fuseEpoch;
+        if (!(c.flags & kContribPending)) {
+            c.flags |= kContribPending;
+            L.pending.emplace_back(key, idx);
+        }
+    }
+}
+
+ElevationMap::ContributionTile* ElevationMap::captureBaseline(const TileKey& key, Tile& tile) {
+    auto it = fusionBaseline.find(key);
+    if (it != fusionBaseline.end()) return it->second.get();
+    std::unique_ptr<ContributionTile> base;
+    const int side = 1 << contribDepth;
+    if (!tile.bounds().empty() && tile.layers.side >= side) {
+        // Sample the center leaf of each contribution cell
+        const int scale = tile.layers.side / side;
+        base = std::make_unique<ContributionTile>();
+        base->cells.resize(static_cast<size_t>(side) * static_cast<size_t>(side));
+        for (int lz = 0; lz < side; ++lz) {
+            for (int lx = 0; lx < side; ++lx) {
+                size_t src = static_cast<size_t>(lz * scale + scale / 2) * tile.layers.side +
+                             static_cast<size_t>(lx * scale + scale / 2);
+                if (!(tile.layers.flags[src] & ELEV_VALID)) continue;
+                ContributionTile::Cell& c = base->cells[static_cast<size_t>(lz) * side + lx];
+                c.mean = tile.layers.height[src];
+                c.var = tile.layers.variance[src];
+                c.n = std::max<uint16_t>(tile.layers.count[src], 1);
+                c.ageEpoch = tile.cellEpoch(tile.layers.age[src]);
+            }
+        }
+    }
+    if (base) {
+        baselineBytes += base->bytes();
+        totals.allocatedBytes += base->bytes();
+    }
+    return (fusionBaseline[key] = std::move(base)).get();
+}
+
+size_t ElevationMap::fuseRoverLayers(double nowTs) {
+    fusePending.clear();
+    for (size_t l = 0; l < roverLayers.size(); ++l) {
+        for (const auto& p : roverLayers[l]->pending) fusePending.push_back({p.first, p.second, static_cast<int>(l)});
+        roverLayers[l]->pending.clear();
+    }
+    // Group by tile so each tile is resolved once per pass
+    std::sort(fusePending.begin(), fusePending.end(), [](const PendingFuse& a, const PendingFuse& b) {
+        if (a.key.tx != b.key.tx) return a.key.tx < b.key.tx;
+        if (a.key.tz != b.key.tz) return a.key.tz < b.key.tz;
+        return a.cell < b.cell;
+    });
+
+    const int side = 1 << contribDepth;
+    const float cellSize = tileSize / static_cast<float>(side);
+    const CellAging aging = agingNow();
+    ScanArena::Scope scratch;
+    ScratchVector<ContributionTile*> layerTiles(roverLayers.size(), nullptr);
+    ScratchVector<ContributionTile::Cell*> inputs;
+    inputs.reserve(roverLayers.size() + 1);
+    ScratchVector<uint16_t> inputN; // aged counts of inputs
+    inputN.reserve(roverLayers.size() + 1);
+    ScratchVector<TileKey> touched;
+    ContributionTile* baseline = nullptr;
+    Tile* out = nullptr;
+    size_t written = 0;
+    for (size_t i = 0; i < fusePending.size(); ++i) {
+        const PendingFuse& p = fusePending[i];
+        const bool sameTile = i > 0 && fusePending[i - 1].key.tx == p.key.tx && fusePending[i - 1].key.tz == p.key.tz;
+        if (sameTile && fusePending[i - 1].cell == p.cell) continue; // queued by several rovers
+        if (!sameTile) {
+            for (size_t l = 0; l < roverLayers.size(); ++l) {
+                auto it = roverLayers[l]->tiles.find(p.key);
+                layerTiles[l] = it != roverLayers[l]->tiles.end() ? it->second.get() : nullptr;
+            }
+            out = &getOrCreateTile(p.key.tx, p.key.tz);
+            baseline = captureBaseline(p.key, *out);
+            touched.push_back(p.key);
+        }
+
+        inputs.clear();
+        for (ContributionTile* t : layerTiles) {
+            if (!t) continue;
+            ContributionTile::Cell& c = t->cells[p.cell];
+            c.flags &= static_cast<uint8_t>(~kContribPending);
+            if (c.n > 0) inputs.push_back(&c);
+        }
+        if (baseline && baseline->cells[p.cell].n > 0) inputs.push_back(&baseline->cells[p.cell]);
+        if (inputs.empty()) continue;
+        // Contributors weigh in with their confidence decayed since they last observed the cell
+        inputN.clear();
+        for (const ContributionTile::Cell* c : inputs)
+            inputN.push_back(aging.epoch > c->ageEpoch ? aging.decay(c->n, aging.epoch - c->ageEpoch) : c->n);
+
+        // A surface confirmed after another contributor last looked supersedes it when they
+        // disagree by a replacement; concurrent disagreement is an offset and gets averaged.
+        // A contributor unobserved for a half-life or more and decayed below Nconf yields to any
+        // disagreeing observation of this pass, as a map cell would to one disagreeing sample.
+        int newest = -1;
+        bool freshNow = false;
+        for (size_t k = 0; k < inputs.size(); ++k) {
+            if (inputN[k] >= K && (newest < 0 || inputs[k]->sinceEpoch > inputs[newest]->sinceEpoch))
+                newest = static_cast<int>(k);
+            if (inputs[k]->lastEpoch == fuseEpoch) freshNow = true;
+        }
+        for (size_t k = 0; k < inputs.size(); ++k) {
+            ContributionTile::Cell* c = inputs[k];
+            bool superseded = false;
+            if (newest >= 0 && static_cast<int>(k) != newest)
+                superseded = c->lastEpoch < inputs[newest]->sinceEpoch &&
+                             std::fabs(c->mean - inputs[newest]->mean) >= tauReplace;
+            if (!superseded && freshNow && c->lastEpoch != fuseEpoch && inputN[k] < Nconf &&
+                aging.epoch - c->ageEpoch >= CellAging::kEpochsPerHalfLife) {
+                for (size_t f = 0; f < inputs.size(); ++f) {
+                    if (inputs[f]->lastEpoch == fuseEpoch && std::fabs(c->mean - inputs[f]->mean) >= tauReplace)
+                        superseded = true;
+                }
+            }
+            if (superseded) c->n = inputN[k] = 0;
+        }
+        double sumW = 0.0, sumWY = 0.0;
+        uint32_t sumN = 0;
+        for (size_t k = 0; k < inputs.size(); ++k) {
+            if (inputN[k] == 0) continue;
+            double w = inputN[k] / static_cast<double>(inputs[k]->var + kFusionMinVariance);
+            sumW += w;
+            sumWY += w * inputs[k]->mean;
+            sumN += inputN[k];
+        }
+        if (sumW <= 0.0) continue;
+        const double fused = sumWY / sumW;
+        // Spread includes the disagreement between contributors
+        double sumWV = 0.0;
+        for (size_t k = 0; k < inputs.size(); ++k) {
+            if (inputN[k] == 0) continue;
+            double w = inputN[k] / static_cast<double>(inputs[k]->var + kFusionMinVariance);
+            double d = inputs[k]->mean - fused;
+            sumWV += w * (inputs[k]->var + d * d);
+        }
+        const int lx = static_cast<int>(p.cell) % side, lz = static_cast<int>(p.cell) / side;
+        const float x = (p.key.tx * side + lx + 0.5f) * cellSize;
+        const float z = (p.key.tz * side + lz + 0.5f) * cellSize;
+        CellChange change;
+        const ElevationStats before = out->stats();
+        if (out->assignCell(x, z, contribDepth, static_cast<float>(fused), static_cast<float>(sumWV / sumW),
+                            static_cast<uint16_t>(std::min<uint32_t>(sumN, static_cast<uint32_t>(Nsat))),
+                            tauUpload, tauReplace, &change, &aging) &&
+            changeCapacity > 0) {
+            recordChange(p.key, change, nowTs, roverLayers[p.layer]->changeRover);
+        }
+        accountTile(before, out->stats());
+        takeTileChanges(p.key, *out);
+        written++;
+    }
+    propagateTileBounds(touched);
+    fuseEpoch++;
+    return written;
 }
 
 std::vector<TileUpdate> ElevationMap::consumeDirtyTiles() {
     std::vector<TileUpdate> updates;
-    for (auto& kv : tiles) {
-        TileKey key = kv.first;
-        Tile& t = kv.second;
-        if (!t.dirty) continue;
+    emitRestored(restoredPending.size(), updates);
+    for (const TileKey& key : uploadPending) {
         TileUpdate up;
         up.key = key;
         up.tileSize = tileSize;
-        t.buildHeightGrid(gridNVertices, up.heights);
+        tiles.at(key)->buildHeightGrid(gridNVertices, up.heights);
         updates.push_back(std::move(up));
-        t.dirty = false;
     }
+    totals.numDirtyTiles -= uploadPending.size();
+    uploadPending.clear();
     return updates;
 }
 
 ElevationStats ElevationMap::getStats() const {
-    ElevationStats st{};
-    st.numTiles = tiles.size();
-    size_t leaves = 0;
-    // rough count via DFS
-    std::vector<const QuadNode*> stack;
-    for (const auto& kv : tiles) {
-        if (kv.second.root) stack.push_back(kv.second.root.get());
-        while (!stack.empty()) {
-            const QuadNode* n = stack.back(); stack.pop_back();
-            if (n->isLeaf) {
-                leaves++;
-            } else {
-                for (int i = 0; i < 4; ++i) if (n->children[i]) stack.push_back(n->children[i].get());
-            }
-        }
+    ElevationStats st = totals;
+    for (const auto& layer : roverLayers) {
+        st.roverLayerBytes += layer->tileBytes;
+        st.allocatedBytes += layer->allocatedBytes;
+    }
+    st.roverLayerBytes += baselineBytes;
+    st.changeBytes += changes.capacity() * sizeof(ChangeEvent);
+    if (store) {
+        // The store keeps a copy of faulted-in tiles too; only count the non-resident ones
+        st.numSpilledTiles = store->tileCount() - residentStored;
+        st.storeBytes = store->fileBytes();
     }
-    st.numLeaves = leaves;
     return st;
 }
 
@@ -293,45 +1410,834 @@ std::vector<TileUpdate> ElevationMap::consumeDirtyTilesBudgeted(size_t maxBytes)
     if (budgetTiles == 0) budgetTiles = 1;
     std::vector<TileUpdate> updates;
     updates.reserve(budgetTiles);
-    for (auto& kv : tiles) {
-        if (updates.size() >= budgetTiles) break;
-        TileKey key = kv.first;
-        Tile& t = kv.second;
-        if (!t.dirty) continue;
+    emitRestored(budgetTiles, updates);
+    for (auto it = uploadPending.begin(); it != uploadPending.end() && updates.size() < budgetTiles;) {
         TileUpdate up;
-        up.key = key; up.tileSize = tileSize;
-        t.buildHeightGrid(gridNVertices, up.heights);
+        up.key = *it; up.tileSize = tileSize;
+        tiles.at(*it)->buildHeightGrid(gridNVertices, up.heights);
         updates.push_back(std::move(up));
-        t.dirty = false;
+        it = uploadPending.erase(it);
+        totals.numDirtyTiles--;
     }
     return updates;
 }
 
 bool ElevationMap::getGroundAt(float x, float z, float* outY, uint16_t* outN) const {
     if (!outY) return false;
-    int tx = static_cast<int>(std::floor(x / tileSize));
-    int tz = static_cast<int>(std::floor(z / tileSize));
-    TileKey key{tx, tz};
-    auto it = tiles.find(key);
-    if (it == tiles.end() || !it->second.root) return false;
-    const Tile& t = it->second;
-    const QuadNode* node = t.root.get();
-    float cx = t.originX + t.size * 0.5f;
-    float cz = t.originZ + t.size * 0.5f;
-    float half = t.size * 0.5f;
-    for (int depth = 0; depth < t.maxDepth - 1 && node && !node->isLeaf; ++depth) {
-        int idx = (x >= cx ? 1 : 0) + (z >= cz ? 2 : 0);
-        half *= 0.5f;
-        cx += (idx == 1 || idx == 3) ? half : -half;
-        cz += (idx >= 2) ? half : -half;
-        node = node->children[idx].get();
-    }
+    const int leafBits = std::max(maxDepth - 1, 0);
+    const int mask = (1 << leafBits) - 1;
+    const float invLeaf = static_cast<float>(1 << leafBits) / tileSize;
+    const int32_t gx = floorToInt(x * invLeaf), gz = floorToInt(z * invLeaf);
+    auto it = tiles.find(TileKey{gx >> leafBits, gz >> leafBits});
+    if (it == tiles.end() || !it->second->root) return false;
+    const Tile& t = *it->second;
+    const QuadNode* node = dispatchLeafDepth(t.leafDepth(), [&](auto leafDepthC) {
+        return descendToward(t, leafDepthC, gx & mask, gz & mask, t.leafDepth());
+    });
     if (!node) return false;
     const ElevCell& c = node->cell;
     if (!c.valid) return false;
+    const uint16_t n = agedCount(t, c.n, c.age, agingNow());
     *outY = c.z_mean;
-    if (outN) *outN = c.n;
-    return c.n >= Nconf;
+    if (outN) *outN = n;
+    return n >= Nconf;
+}
+
+void ElevationMap::getGroundAtBatch(const float* xs, const float* zs, size_t count,
+                                    float* outY, uint16_t* outN, uint8_t* outOk,
+                                    float* outNormals) const {
+    if (count == 0 || !xs || !zs || !outY) return;
+    dispatchLeafDepth(std::max(maxDepth - 1, 0), [&](auto leafDepthC) {
+        getGroundAtBatchAt(leafDepthC, xs, zs, count, outY, outN, outOk, outNormals);
+    });
+}
+
+template <typename LeafDepth>
+void ElevationMap::getGroundAtBatchAt(LeafDepth leafDepthC, const float* xs, const float* zs, size_t count,
+                                      float* outY, uint16_t* outN, uint8_t* outOk,
+                                      float* outNormals) const {
+    const int leafBits = static_cast<int>(leafDepthC);
+    const int side = 1 << leafBits;
+    const int mask = side - 1;
+    const float invLeaf = static_cast<float>(side) / tileSize;
+
+    // Pass 1: global leaf coordinates. Kept free of calls and branches so it vectorizes.
+    ScanArena::Scope scratch;
+    ScratchVector<int32_t> gx(count), gz(count);
+    for (size_t i = 0; i < count; ++i) {
+        gx[i] = floorToInt(xs[i] * invLeaf);
+        gz[i] = floorToInt(zs[i] * invLeaf);
+    }
+
+    // Pass 2: group by tile so each tile is looked up once. Queries are usually spatially
+    // coherent, so the hash is only consulted when the tile changes from the previous point.
+    ScratchVector<uint32_t> group(count);
+    ScratchVector<const Tile*> groupTiles;
+    ScratchHashMap<uint64_t, uint32_t> groupIndex;
+    uint64_t lastKey = 0;
+    uint32_t lastGroup = 0;
+    for (size_t i = 0; i < count; ++i) {
+        int32_t tx = gx[i] >> leafBits;
+        int32_t tz = gz[i] >> leafBits;
+        uint64_t k = (static_cast<uint64_t>(static_cast<uint32_t>(tx)) << 32) | static_cast<uint32_t>(tz);
+        if (i == 0 || k != lastKey) {
+            auto ins = groupIndex.emplace(k, static_cast<uint32_t>(groupTiles.size()));
+            if (ins.second) {
+                auto it = tiles.find(TileKey{tx, tz});
+                groupTiles.push_back((it != tiles.end() && it->second->layers.side == side) ? it->second.get() : nullptr);
+            }
+            lastKey = k;
+            lastGroup = ins.first->second;
+        }
+        group[i] = lastGroup;
+    }
+
+    // Pass 3: gather from the dense layers
+    const CellAging aging = agingNow();
+    for (size_t i = 0; i < count; ++i) {
+        const Tile* t = groupTiles[group[i]];
+        if (!t) {
+            if (outN) outN[i] = 0;
+            if (outOk) outOk[i] = 0;
+            continue;
+        }
+        size_t local = static_cast<size_t>(gz[i] & mask) * side + static_cast<size_t>(gx[i] & mask);
+        uint16_t n = agedCount(*t, t->layers.count[local], t->layers.age[local], aging);
+        bool valid = (t->layers.flags[local] & ELEV_VALID) != 0;
+        if (valid) outY[i] = t->layers.height[local];
+        if (outN) outN[i] = n;
+        if (outOk) outOk[i] = (valid && n >= Nconf) ? 1 : 0;
+    }
+    if (!outNormals) return;
+
+    // Height of a global leaf cell; the query point's own tile is already resolved
+    auto cellHeight = [&](int32_t cx, int32_t cz, size_t i, float* h) {
+        const Tile* t = groupTiles[group[i]];
+        if ((cx >> leafBits) != (gx[i] >> leafBits) || (cz >> leafBits) != (gz[i] >> leafBits)) {
+            auto it = tiles.find(TileKey{cx >> leafBits, cz >> leafBits});
+            if (it == tiles.end() || it->second->layers.side != side) return false;
+            t = it->second.get();
+        }
+        size_t local = static_cast<size_t>(cz & mask) * side + static_cast<size_t>(cx & mask);
+        if (!(t->layers.flags[local] & ELEV_VALID)) return false;
+        *h = t->layers.height[local];
+        return true;
+    };
+    const float leafSize = tileSize / static_cast<float>(side);
+    for (size_t i = 0; i < count; ++i) {
+        float* nrm = outNormals + i * 3;
+        nrm[0] = 0.0f; nrm[1] = 1.0f; nrm[2] = 0.0f;
+        if (!groupTiles[group[i]]) continue;
+        // Bilinear patch over the four cell centers surrounding the point
+        float u = xs[i] * invLeaf - 0.5f;
+        float v = zs[i] * invLeaf - 0.5f;
+        int32_t i0 = static_cast<int32_t>(std::floor(u));
+        int32_t j0 = static_cast<int32_t>(std::floor(v));
+        float fu = u - static_cast<float>(i0);
+        float fv = v - static_cast<float>(j0);
+        float h00, h10, h01, h11;
+        if (!cellHeight(i0, j0, i, &h00) || !cellHeight(i0 + 1, j0, i, &h10) ||
+            !cellHeight(i0, j0 + 1, i, &h01) || !cellHeight(i0 + 1, j0 + 1, i, &h11))
+            continue;
+        float dYdX = ((h10 - h00) * (1.0f - fv) + (h11 - h01) * fv) / leafSize;
+        float dYdZ = ((h01 - h00) * (1.0f - fu) + (h11 - h10) * fu) / leafSize;
+        float len = std::sqrt(dYdX * dYdX + 1.0f + dYdZ * dYdZ);
+        nrm[0] = -dYdX / len;
+        nrm[1] = 1.0f / len;
+        nrm[2] = -dYdZ / len;
+    }
+}
+
+
+// ---- Traversability ----
+void ElevationMap::setTraversabilityPolicy(const TraversabilityPolicy& policy) {
+    travPolicy = policy;
+    const int side = 1 << std::max(maxDepth - 1, 0);
+    for (const TileKey& key : residentKeys()) getOrCreateTile(key.tx, key.tz).markTraversabilityStale(0, 0, side - 1, side - 1);
+}
+
+size_t ElevationMap::updateTraversability(size_t maxCells) {
+    const int leafBits = std::max(maxDepth - 1, 0);
+    const int side = 1 << leafBits;
+    // Stale cells past a tile's edge belong to its neighbours; hand them over (resident only).
+    // Tiles may be shared with a snapshot, so only writes that change one go through getOrCreateTile
+    // Writes replace entries of `tiles`, so both passes walk a copy of the keys
+    const std::vector<TileKey> keys = residentKeys();
+    for (const TileKey& key : keys) {
+        const Tile& shared = *tiles.at(key);
+        if (!shared.traversabilityStale()) continue;
+        if (shared.travX0 >= 0 && shared.travZ0 >= 0 && shared.travX1 < side && shared.travZ1 < side) continue;
+        const int tx0 = shared.travX0, tz0 = shared.travZ0, tx1 = shared.travX1, tz1 = shared.travZ1;
+        for (int dz = -1; dz <= 1; ++dz) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                if (dx == 0 && dz == 0) continue;
+                int x0 = std::max(tx0, dx * side), x1 = std::min(tx1, dx * side + side - 1);
+                int z0 = std::max(tz0, dz * side), z1 = std::min(tz1, dz * side + side - 1);
+                if (x0 > x1 || z0 > z1) continue;
+                TileKey nk{key.tx + dx, key.tz + dz};
+                auto it = tiles.find(nk);
+                if (it == tiles.end()) continue;
+                x0 -= dx * side; z0 -= dz * side; x1 -= dx * side; z1 -= dz * side;
+                const Tile& nb = *it->second;
+                if (nb.traversabilityStale() && nb.travX0 <= x0 && nb.travZ0 <= z0 &&
+                    nb.travX1 >= x1 && nb.travZ1 >= z1)
+                    continue;
+                getOrCreateTile(nk.tx, nk.tz).markTraversabilityStale(x0, z0, x1, z1);
+            }
+        }
+        Tile& t = getOrCreateTile(key.tx, key.tz);
+        t.travX0 = std::max(t.travX0, 0); t.travZ0 = std::max(t.travZ0, 0);
+        t.travX1 = std::min(t.travX1, side - 1); t.travZ1 = std::min(t.travZ1, side - 1);
+    }
+
+    const float leafSize = tileSize / static_cast<float>(side);
+    size_t computed = 0;
+    for (const TileKey& key : keys) {
+        if (computed >= maxCells) break;
+        if (!tiles.at(key)->traversabilityStale()) continue;
+        Tile& t = getOrCreateTile(key.tx, key.tz); // copy first if a snapshot holds it
+        if (t.layers.side != side) continue;
+        if (t.traversability.side != side) {
+            // First computation: every observed cell is stale
+            const ElevationStats before = t.stats();
+            t.traversability.reset(side);
+            t.markTraversabilityStale(0, 0, side - 1, side - 1);
+            accountTile(before, t.stats());
+        }
+        const int x0 = t.travX0, z0 = t.travZ0;
+        const int cols = t.travX1 - x0 + 1, rows = t.travZ1 - z0 + 1;
+        t.travX0 = t.travZ0 = 1;
+        t.travX1 = t.travZ1 = 0;
+
+        // Window of the stale cells plus a one-cell ring, which may come from the 8 neighbours
+        const Tile* around[9];
+        for (int i = 0; i < 9; ++i) {
+            int dx = i % 3 - 1, dz = i / 3 - 1;
+            if (dx == 0 && dz == 0) {
+                around[i] = &t;
+                continue;
+            }
+            auto it = tiles.find(TileKey{key.tx + dx, key.tz + dz});
+            around[i] = (it != tiles.end() && it->second->layers.side == side) ? it->second.get() : nullptr;
+        }
+        const size_t stride = static_cast<size_t>(cols) + 2;
+        travHeights.assign(stride * static_cast<size_t>(rows + 2), 0.0f);
+        travValid.assign(stride * static_cast<size_t>(rows + 2), 0.0f);
+        for (int wz = 0; wz < rows + 2; ++wz) {
+            const int lz = z0 - 1 + wz;
+            const int tzOff = lz < 0 ? 0 : (lz >= side ? 2 : 1);
+            const size_t src = static_cast<size_t>(lz & (side - 1)) * side;
+            for (int wx = 0; wx < cols + 2; ++wx) {
+                const int lx = x0 - 1 + wx;
+                const Tile* nb = around[tzOff * 3 + (lx < 0 ? 0 : (lx >= side ? 2 : 1))];
+                if (!nb) continue;
+                const size_t cell = src + static_cast<size_t>(lx & (side - 1));
+                if (!(nb->layers.flags[cell] & ELEV_VALID)) continue;
+                travHeights[wz * stride + wx] = nb->layers.height[cell];
+                travValid[wz * stride + wx] = 1.0f;
+            }
+        }
+        const size_t first = static_cast<size_t>(z0) * side + static_cast<size_t>(x0);
+        TraversabilityLayers& tl = t.traversability;
+        computeTraversability(TraversabilityWindow{travHeights.data(), travValid.data(), stride}, cols, rows, leafSize,
+                              travPolicy,
+                              TraversabilityRows{tl.slope.data() + first, tl.step.data() + first,
+                                                 tl.roughness.data() + first, tl.cost.data() + first,
+                                                 static_cast<size_t>(side)});
+        computed += static_cast<size_t>(cols) * static_cast<size_t>(rows);
+    }
+    return computed;
+}
+
+bool ElevationMap::getTraversabilityAt(float x, float z, TraversabilityCell* out) const {
+    if (!out) return false;
+    const int leafBits = std::max(maxDepth - 1, 0);
+    const int side = 1 << leafBits;
+    const float invLeaf = static_cast<float>(side) / tileSize;
+    const int32_t gx = floorToInt(x * invLeaf), gz = floorToInt(z * invLeaf);
+    auto it = tiles.find(TileKey{gx >> leafBits, gz >> leafBits});
+    if (it == tiles.end()) return false;
+    const TraversabilityLayers& tl = it->second->traversability;
+    if (tl.side != side) return false;
+    const size_t local = static_cast<size_t>(gz & (side - 1)) * side + static_cast<size_t>(gx & (side - 1));
+    if (tl.cost[local] == kTraversabilityUnknown) return false;
+    out->slopeDeg = static_cast<float>(std::atan(tl.slope[local]) * (180.0 / 3.14159265358979323846));
+    out->step = tl.step[local];
+    out->roughness = tl.roughness[local];
+    out->cost = static_cast<float>(tl.cost[local]) / 254.0f;
+    return true;
 }
 
+std::vector<ChangeEvent> ElevationMap::consumeChanges() {
+    std::vector<ChangeEvent> out;
+    out.swap(changes);
+    changeIndex.clear();
+    regionIndex.clear();
+    coarsestChange = 0;
+    return out;
+}
+
+uint16_t ElevationMap::changeRoverId(const std::string& rover) {
+    auto it = changeRoverIds.find(rover);
+    if (it != changeRoverIds.end()) return it->second;
+    // Ids are never reused; past 65535 sources the last id is shared
+    const uint16_t id = static_cast<uint16_t>(std::min<size_t>(changeRovers.size(), 0xffff));
+    if (changeRovers.size() <= 0xffff) changeRovers.push_back(rover);
+    changeRoverIds.emplace(rover, id);
+    return id;
+}
+
+const std::string& ElevationMap::changeRoverName(uint16_t id) const {
+    static const std::string unknown;
+    return id < changeRovers.size() ? changeRovers[id] : unknown;
+}
+
+namespace {
+uint64_t globalCellKey(const TileKey& key, int side, int cx, int cz) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(key.tx * side + cx)) << 32) |
+           static_cast<uint32_t>(key.tz * side + cz);
+}
 
+// Folds one more change into a region event (running means of old/new height)
+void foldIntoRegion(ChangeEvent& e, int cx, int cz, float oldY, float newY, uint32_t merged) {
+    uint32_t total = e.merged + merged;
+    float w = static_cast<float>(merged) / static_cast<float>(total);
+    e.oldY += (oldY - e.oldY) * w;
+    e.newY += (newY - e.newY) * w;
+    e.merged = total;
+    e.cellX0 = std::min(e.cellX0, cx); e.cellX1 = std::max(e.cellX1, cx);
+    e.cellZ0 = std::min(e.cellZ0, cz); e.cellZ1 = std::max(e.cellZ1, cz);
+}
+
+ChangeEvent emptyRegion(const TileKey& tile, int tileSpan) {
+    ChangeEvent region;
+    region.tile = tile;
+    region.tileSpan = tileSpan;
+    region.region = true;
+    region.merged = 0;
+    region.cellX0 = region.cellZ0 = std::numeric_limits<int>::max();
+    region.cellX1 = region.cellZ1 = std::numeric_limits<int>::min();
+    return region;
+}
+
+// Folds a whole event into a region event; side is the tile edge in cells
+void foldEvent(ChangeEvent& region, const ChangeEvent& e, int side) {
+    const int ox = (e.tile.tx - region.tile.tx) * side, oz = (e.tile.tz - region.tile.tz) * side;
+    foldIntoRegion(region, ox + e.cellX0, oz + e.cellZ0, e.oldY, e.newY, e.merged);
+    region.cellX1 = std::max(region.cellX1, ox + e.cellX1);
+    region.cellZ1 = std::max(region.cellZ1, oz + e.cellZ1);
+    region.maxDelta = std::max(region.maxDelta, e.maxDelta);
+    region.kind |= e.kind;
+    if (e.timestamp >= region.timestamp) {
+        region.timestamp = e.timestamp;
+        region.rover = e.rover;
+    }
+}
+
+int spanLevel(int tileSpan) {
+    int level = 0;
+    while ((1 << level) < tileSpan) ++level;
+    return level;
+}
+}
+
+void ElevationMap::recordChange(const TileKey& key, const CellChange& c, double ts, uint16_t rover) {
+    float delta = std::fabs(c.newY - c.oldY);
+    const int side = 1 << std::max(maxDepth - 1, 0);
+    // A region event covering the tile takes the change, at whatever level it was merged
+    for (int level = 0; level <= coarsestChange; ++level) {
+        auto r = regionIndex.find(std::make_pair(level, TileKey{key.tx >> level, key.tz >> level}));
+        if (r == regionIndex.end()) continue;
+        ChangeEvent& e = changes[r->second];
+        const int ox = (key.tx - e.tile.tx) * side, oz = (key.tz - e.tile.tz) * side;
+        foldIntoRegion(e, ox + c.cellX, oz + c.cellZ, c.oldY, c.newY, 1);
+        e.maxDelta = std::max(e.maxDelta, delta);
+        e.kind |= c.kind;
+        e.timestamp = ts;
+        e.rover = rover;
+        return;
+    }
+    uint64_t cellKey = globalCellKey(key, side, c.cellX, c.cellZ);
+    auto it = changeIndex.find(cellKey);
+    if (it != changeIndex.end()) {
+        ChangeEvent& e = changes[it->second];
+        e.newY = c.newY;
+        e.maxDelta = std::max(e.maxDelta, std::fabs(e.newY - e.oldY));
+        e.merged++;
+        e.kind |= c.kind;
+        e.timestamp = ts;
+        e.rover = rover;
+        return;
+    }
+    if (changes.size() >= changeCapacity) {
+        // Out of room; this tile may have collapsed into a region event meanwhile
+        makeRoomForChanges();
+        recordChange(key, c, ts, rover);
+        return;
+    }
+    ChangeEvent e;
+    e.tile = key;
+    e.cellX0 = e.cellX1 = c.cellX;
+    e.cellZ0 = e.cellZ1 = c.cellZ;
+    e.oldY = c.oldY;
+    e.newY = c.newY;
+    e.maxDelta = delta;
+    e.kind = c.kind;
+    e.timestamp = ts;
+    e.rover = rover;
+    changeIndex.emplace(cellKey, static_cast<uint32_t>(changes.size()));
+    changes.push_back(e);
+}
+
+void ElevationMap::makeRoomForChanges() {
+    // Down to a low-water mark, so a full stream is not reorganized on every new event
+    const size_t target = changeCapacity - std::max<size_t>(changeCapacity / 8, 1);
+    std::map<TileKey, uint32_t> cellEvents;
+    for (const ChangeEvent& e : changes) {
+        if (!e.region) cellEvents[e.tile]++;
+    }
+    std::vector<std::pair<uint32_t, TileKey>> busiest;
+    for (const auto& kv : cellEvents) {
+        if (kv.second >= 2) busiest.emplace_back(kv.second, kv.first);
+    }
+    std::sort(busiest.begin(), busiest.end(),
+              [](const auto& a, const auto& b) { return a.first > b.first; });
+    // Collapsing a tile of n cell events frees n - 1 slots
+    std::set<TileKey> collapse;
+    size_t size = changes.size();
+    for (const auto& b : busiest) {
+        if (size <= target) break;
+        collapse.insert(b.second);
+        size -= b.first - 1;
+    }
+    if (!collapse.empty()) collapseChanges(collapse);
+    // Every tile is down to one event: merge blocks of 2x2, 4x4, ... tiles. Nothing is
+    // dropped, consumers get coarser rectangles. Past level 30 at most four blocks remain.
+    for (int level = 1; level < 32 && changes.size() > target; ++level) mergeChangeBlocks(level);
+}
+
+void ElevationMap::reindexChanges() {
+    changeIndex.clear();
+    regionIndex.clear();
+    coarsestChange = 0;
+    const int side = 1 << std::max(maxDepth - 1, 0);
+    for (size_t i = 0; i < changes.size(); ++i) {
+        const ChangeEvent& e = changes[i];
+        if (e.region) {
+            const int level = spanLevel(e.tileSpan);
+            regionIndex[std::make_pair(level, TileKey{e.tile.tx >> level, e.tile.tz >> level})] = static_cast<uint32_t>(i);
+            coarsestChange = std::max(coarsestChange, level);
+        } else {
+            changeIndex.emplace(globalCellKey(e.tile, side, e.cellX0, e.cellZ0), static_cast<uint32_t>(i));
+        }
+    }
+}
+
+void ElevationMap::collapseChanges(const std::set<TileKey>& keys) {
+    const int side = 1 << std::max(maxDepth - 1, 0);
+    std::map<TileKey, ChangeEvent> regions;
+    size_t keep = 0;
+    for (size_t i = 0; i < changes.size(); ++i) {
+        ChangeEvent& e = changes[i];
+        if (!e.region && keys.count(e.tile)) {
+            auto r = regions.find(e.tile);
+            if (r == regions.end()) r = regions.emplace(e.tile, emptyRegion(e.tile, 1)).first;
+            foldEvent(r->second, e, side);
+            continue;
+        }
+        if (keep != i) changes[keep] = e;
+        ++keep;
+    }
+    changes.resize(keep);
+    for (auto& kv : regions) changes.push_back(kv.second);
+    reindexChanges();
+}
+
+void ElevationMap::mergeChangeBlocks(int level) {
+    const int side = 1 << std::max(maxDepth - 1, 0);
+    const int span = 1 << level;
+    // Events already as coarse as the blocks stay; the others merge where a block holds two or more
+    std::map<TileKey, uint32_t> perBlock;
+    for (const ChangeEvent& e : changes) {
+        if (e.tileSpan < span) perBlock[TileKey{e.tile.tx >> level, e.tile.tz >> level}]++;
+    }
+    std::map<TileKey, ChangeEvent> regions;
+    size_t keep = 0;
+    for (size_t i = 0; i < changes.size(); ++i) {
+        const ChangeEvent& e = changes[i];
+        const TileKey block{e.tile.tx >> level, e.tile.tz >> level};
+        if (e.tileSpan < span && perBlock[block] >= 2) {
+            auto r = regions.find(block);
+            if (r == regions.end())
+                r = regions.emplace(block, emptyRegion(TileKey{block.tx * span, block.tz * span}, span)).first;
+            foldEvent(r->second, e, side);
+            continue;
+        }
+        if (keep != i) changes[keep] = e;
+        ++keep;
+    }
+    changes.resize(keep);
+    for (auto& kv : regions) changes.push_back(kv.second);
+    reindexChanges();
+}
+
+void ElevationMap::updatePyramid(const TileKey& key, const HeightBounds& b) {
+    pyramid[0][key] = b;
+    TileKey k = key;
+    for (int level = 1; level < kPyramidLevels; ++level) {
+        // Arithmetic shift floors negative indices as well
+        TileKey parent{k.tx >> 1, k.tz >> 1};
+        HeightBounds parts[4];
+        const auto& below = pyramid[level - 1];
+        for (int i = 0; i < 4; ++i) {
+            auto it = below.find(TileKey{parent.tx * 2 + (i & 1), parent.tz * 2 + (i >> 1)});
+            if (it != below.end()) parts[i] = it->second;
+        }
+        HeightBounds combined = combineBounds(parts, 4);
+        auto it = pyramid[level].find(parent);
+        if (it != pyramid[level].end() && it->second == combined) break; // nothing above can change either
+        pyramid[level][parent] = combined;
+        k = parent;
+    }
+}
+
+bool ElevationMap::getPyramidBounds(int level, int cx, int cz, HeightBounds* out) const {
+    if (!out || level < 0 || level >= kPyramidLevels) return false;
+    auto it = pyramid[level].find(TileKey{cx, cz});
+    if (it == pyramid[level].end() || it->second.empty()) return false;
+    *out = it->second;
+    return true;
+}
+
+namespace {
+// Area-weighted accumulation of bounds over a query rectangle
+struct BoundsAccumulator {
+    HeightBounds b;
+    double weightedSum = 0.0;
+    double area = 0.0;
+    void add(const HeightBounds& part, double partArea) {
+        if (part.empty()) return;
+        b.minY = std::min(b.minY, part.minY);
+        b.maxY = std::max(b.maxY, part.maxY);
+        weightedSum += static_cast<double>(part.mean) * partArea;
+        area += partArea;
+    }
+};
+
+struct Rect {
+    float minX, minZ, maxX, maxZ;
+    bool contains(const Rect& o) const { return o.minX >= minX && o.maxX <= maxX && o.minZ >= minZ && o.maxZ <= maxZ; }
+    bool overlaps(const Rect& o) const { return o.minX < maxX && o.maxX > minX && o.minZ < maxZ && o.maxZ > minZ; }
+    double overlapArea(const Rect& o) const {
+        double w = std::min(maxX, o.maxX) - std::max(minX, o.minX);
+        double h = std::min(maxZ, o.maxZ) - std::max(minZ, o.minZ);
+        return (w > 0.0 && h > 0.0) ? w * h : 0.0;
+    }
+};
+
+void collectNodeBounds(const QuadNode* node, const Rect& nodeRect, const Rect& query, BoundsAccumulator& acc) {
+    if (!node || node->bounds.empty() || !query.overlaps(nodeRect)) return;
+    if (node->isLeaf || query.contains(nodeRect)) {
+        acc.add(node->bounds, query.overlapArea(nodeRect));
+        return;
+    }
+    float midX = 0.5f * (nodeRect.minX + nodeRect.maxX);
+    float midZ = 0.5f * (nodeRect.minZ + nodeRect.maxZ);
+    const Rect childRects[4] = {
+        {nodeRect.minX, nodeRect.minZ, midX, midZ}, // SW
+        {midX, nodeRect.minZ, nodeRect.maxX, midZ}, // SE
+        {nodeRect.minX, midZ, midX, nodeRect.maxZ}, // NW
+        {midX, midZ, nodeRect.maxX, nodeRect.maxZ}, // NE
+    };
+    for (int i = 0; i < 4; ++i) collectNodeBounds(node->children[i].get(), childRects[i], query, acc);
+}
+}
+
+bool ElevationMap::getHeightBounds(float minX, float minZ, float maxX, float maxZ, HeightBounds* out) const {
+    if (!out || !(maxX > minX) || !(maxZ > minZ)) return false;
+    const Rect query{minX, minZ, maxX, maxZ};
+    int tx0 = static_cast<int>(std::floor(minX / tileSize));
+    int tz0 = static_cast<int>(std::floor(minZ / tileSize));
+    int tx1 = static_cast<int>(std::floor(maxX / tileSize));
+    int tz1 = static_cast<int>(std::floor(maxZ / tileSize));
+    // Start at the coarsest level where the query spans at most two cells per axis
+    int top = 0;
+    while (top + 1 < kPyramidLevels && ((tx1 >> top) - (tx0 >> top) > 1 || (tz1 >> top) - (tz0 >> top) > 1)) top++;
+
+    BoundsAccumulator acc;
+    ScanArena::Scope scratch;
+    ScratchVector<std::pair<int, TileKey>> stack;
+    for (int cz = tz0 >> top; cz <= (tz1 >> top); ++cz) {
+        for (int cx = tx0 >> top; cx <= (tx1 >> top); ++cx) stack.emplace_back(top, TileKey{cx, cz});
+    }
+    while (!stack.empty()) {
+        auto [level, key] = stack.back();
+        stack.pop_back();
+        auto it = pyramid[level].find(key);
+        if (it == pyramid[level].end() || it->second.empty()) continue;
+        float cellSize = tileSize * static_cast<float>(1 << level);
+        Rect cellRect{key.tx * cellSize, key.tz * cellSize, (key.tx + 1) * cellSize, (key.tz + 1) * cellSize};
+        if (!query.overlaps(cellRect)) continue;
+        if (query.contains(cellRect)) {
+            acc.add(it->second, cellRect.overlapArea(cellRect));
+        } else if (level > 0) {
+            for (int i = 0; i < 4; ++i) stack.emplace_back(level - 1, TileKey{key.tx * 2 + (i & 1), key.tz * 2 + (i >> 1)});
+        } else {
+            auto tIt = tiles.find(key);
+            if (tIt != tiles.end() && tIt->second->root) {
+                collectNodeBounds(tIt->second->root.get(), cellRect, query, acc);
+            } else {
+                acc.add(it->second, query.overlapArea(cellRect)); // spilled: whole-tile bounds
+            }
+        }
+    }
+    if (acc.b.empty()) return false;
+    acc.b.mean = acc.area > 0.0 ? static_cast<float>(acc.weightedSum / acc.area) : 0.0f;
+    *out = acc.b;
+    return true;
+}
+
+bool ElevationMap::extractRegion(float minX, float minZ, float maxX, float maxZ, RegionView* out) const {
+    if (!out || !(maxX > minX) || !(maxZ > minZ)) return false;
+    const int leafBits = std::max(maxDepth - 1, 0);
+    const int side = 1 << leafBits;
+    const int mask = side - 1;
+    const float leafSize = tileSize / static_cast<float>(side);
+    const float invLeaf = static_cast<float>(side) / tileSize;
+    int gx0 = floorToInt(minX * invLeaf);
+    int gz0 = floorToInt(minZ * invLeaf);
+    int gx1 = -floorToInt(-maxX * invLeaf); // exclusive
+    int gz1 = -floorToInt(-maxZ * invLeaf);
+    if (gx1 <= gx0 || gz1 <= gz0) return false;
+
+    RegionView& v = *out;
+    v.originX = gx0 * leafSize;
+    v.originZ = gz0 * leafSize;
+    v.cellSize = leafSize;
+    v.cols = gx1 - gx0;
+    v.rows = gz1 - gz0;
+
+    int tx0 = gx0 >> leafBits, tz0 = gz0 >> leafBits;
+    int tx1 = (gx1 - 1) >> leafBits, tz1 = (gz1 - 1) >> leafBits;
+    if (tx0 == tx1 && tz0 == tz1) {
+        auto it = tiles.find(TileKey{tx0, tz0});
+        if (it != tiles.end() && it->second->layers.side == side) {
+            const CellLayers& l = it->second->layers;
+            size_t first = static_cast<size_t>(gz0 & mask) * side + static_cast<size_t>(gx0 & mask);
+            v.stitched = false;
+            v.height = {l.height.data() + first, static_cast<size_t>(side)};
+            v.variance = {l.variance.data() + first, static_cast<size_t>(side)};
+            v.count = {l.count.data() + first, static_cast<size_t>(side)};
+            v.flags = {l.flags.data() + first, static_cast<size_t>(side)};
+            return true;
+        }
+    }
+
+    // Stitch: copy the row span each tile contributes
+    size_t cells = static_cast<size_t>(v.cols) * static_cast<size_t>(v.rows);
+    v.stitched = true;
+    v.heightBuf.assign(cells, 0.0f);
+    v.varianceBuf.assign(cells, 0.0f);
+    v.countBuf.assign(cells, 0);
+    v.flagsBuf.assign(cells, 0);
+    for (int tz = tz0; tz <= tz1; ++tz) {
+        for (int tx = tx0; tx <= tx1; ++tx) {
+            auto it = tiles.find(TileKey{tx, tz});
+            if (it == tiles.end() || it->second->layers.side != side) continue;
+            const CellLayers& l = it->second->layers;
+            int cx0 = std::max(gx0, tx << leafBits), cx1 = std::min(gx1, (tx + 1) << leafBits);
+            int cz0 = std::max(gz0, tz << leafBits), cz1 = std::min(gz1, (tz + 1) << leafBits);
+            size_t span = static_cast<size_t>(cx1 - cx0);
+            for (int gz = cz0; gz < cz1; ++gz) {
+                size_t src = static_cast<size_t>(gz & mask) * side + static_cast<size_t>(cx0 & mask);
+                size_t dst = static_cast<size_t>(gz - gz0) * v.cols + static_cast<size_t>(cx0 - gx0);
+                std::memcpy(&v.heightBuf[dst], &l.height[src], span * sizeof(float));
+                std::memcpy(&v.varianceBuf[dst], &l.variance[src], span * sizeof(float));
+                std::memcpy(&v.countBuf[dst], &l.count[src], span * sizeof(uint16_t));
+                std::memcpy(&v.flagsBuf[dst], &l.flags[src], span * sizeof(uint8_t));
+            }
+        }
+    }
+    v.height = {v.heightBuf.data(), static_cast<size_t>(v.cols)};
+    v.variance = {v.varianceBuf.data(), static_cast<size_t>(v.cols)};
+    v.count = {v.countBuf.data(), static_cast<size_t>(v.cols)};
+    v.flags = {v.flagsBuf.data(), static_cast<size_t>(v.cols)};
+    return true;
+}
+
+namespace {
+struct Ray {
+    float ox, oy, oz, dx, dy, dz, tMax;
+};
+
+// Parametric interval of the ray inside an XZ rectangle, clipped to [0, tMax]
+bool rayRectInterval(const Ray& r, const Rect& rect, float& t0, float& t1) {
+    t0 = 0.0f;
+    t1 = r.tMax;
+    auto slab = [&](float o, float d, float lo, float hi) {
+        if (std::fabs(d) < 1e-12f) return o >= lo && o < hi;
+        float a = (lo - o) / d, b = (hi - o) / d;
+        if (a > b) std::swap(a, b);
+        t0 = std::max(t0, a);
+        t1 = std::min(t1, b);
+        return t0 <= t1;
+    };
+    return slab(r.ox, r.dx, rect.minX, rect.maxX) && slab(r.oz, r.dz, rect.minZ, rect.maxZ);
+}
+
+// The ray stays above everything in a region over [t0, t1]
+inline bool rayPassesAbove(const Ray& r, float t0, float t1, const HeightBounds& b) {
+    return b.empty() || std::min(r.oy + r.dy * t0, r.oy + r.dy * t1) > b.maxY;
+}
+
+inline Rect childRect(const Rect& r, int i) {
+    float midX = 0.5f * (r.minX + r.maxX);
+    float midZ = 0.5f * (r.minZ + r.maxZ);
+    return {(i & 1) ? midX : r.minX, (i & 2) ? midZ : r.minZ, (i & 1) ? r.maxX : midX, (i & 2) ? r.maxZ : midZ};
+}
+
+struct RayCandidate {
+    int index;
+    Rect rect;
+    float t0, t1;
+};
+
+// Children overlapping the ray, nearest first. Disjoint squares give disjoint intervals,
+// so the first hit found in this order is the nearest one.
+int orderChildren(const Ray& r, const Rect& parent, RayCandidate out[4]) {
+    int count = 0;
+    for (int i = 0; i < 4; ++i) {
+        RayCandidate c{i, childRect(parent, i), 0.0f, 0.0f};
+        if (rayRectInterval(r, c.rect, c.t0, c.t1)) out[count++] = c;
+    }
+    std::sort(out, out + count, [](const RayCandidate& a, const RayCandidate& b) { return a.t0 < b.t0; });
+    return count;
+}
+
+bool raycastNode(const Ray& r, const QuadNode* node, const Rect& rect, float t0, float t1,
+                 float* tHit, const QuadNode** leaf, Rect* leafRect) {
+    if (!node || rayPassesAbove(r, t0, t1, node->bounds)) return false;
+    if (node->isLeaf) {
+        float h = node->cell.z_mean;
+        float t = t0;
+        if (r.oy + r.dy * t0 > h) {
+            // Entered above the column: hit its top if the ray comes down inside the cell
+            if (r.dy >= 0.0f) return false;
+            t = (h - r.oy) / r.dy;
+            if (t > t1) return false;
+        }
+        *tHit = t;
+        *leaf = node;
+        *leafRect = rect;
+        return true;
+    }
+    RayCandidate kids[4];
+    int count = orderChildren(r, rect, kids);
+    for (int k = 0; k < count; ++k) {
+        if (raycastNode(r, node->children[kids[k].index].get(), kids[k].rect, kids[k].t0, kids[k].t1, tHit, leaf, leafRect))
+            return true;
+    }
+    return false;
+}
+}
+
+bool ElevationMap::raycast(float ox, float oy, float oz, float dx, float dy, float dz,
+                           float maxDist, RayHit* out) const {
+    float len = std::sqrt(dx * dx + dy * dy + dz * dz);
+    if (!(len > 0.0f) || !(maxDist > 0.0f)) return false;
+    const Ray ray{ox, oy, oz, dx / len, dy / len, dz / len, maxDist};
+
+    // XZ footprint of the segment picks the starting pyramid level, as in getHeightBounds
+    float ex = ox + ray.dx * maxDist, ez = oz + ray.dz * maxDist;
+    int tx0 = static_cast<int>(std::floor(std::min(ox, ex) / tileSize));
+    int tz0 = static_cast<int>(std::floor(std::min(oz, ez) / tileSize));
+    int tx1 = static_cast<int>(std::floor(std::max(ox, ex) / tileSize));
+    int tz1 = static_cast<int>(std::floor(std::max(oz, ez) / tileSize));
+    int top = 0;
+    while (top + 1 < kPyramidLevels && ((tx1 >> top) - (tx0 >> top) > 1 || (tz1 >> top) - (tz0 >> top) > 1)) top++;
+
+    // Pyramid cells nearest first; each expands into its four children in ray order
+    struct Entry {
+        int level;
+        TileKey key;
+        float t0, t1;
+    };
+    ScanArena::Scope scratch;
+    ScratchVector<Entry> roots;
+    for (int cz = tz0 >> top; cz <= (tz1 >> top); ++cz) {
+        for (int cx = tx0 >> top; cx <= (tx1 >> top); ++cx) {
+            float cellSize = tileSize * static_cast<float>(1 << top);
+            Rect rect{cx * cellSize, cz * cellSize, (cx + 1) * cellSize, (cz + 1) * cellSize};
+            float t0, t1;
+            if (rayRectInterval(ray, rect, t0, t1)) roots.push_back({top, TileKey{cx, cz}, t0, t1});
+        }
+    }
+    std::sort(roots.begin(), roots.end(), [](const Entry& a, const Entry& b) { return a.t0 > b.t0; });
+    ScratchVector<Entry> stack(roots.begin(), roots.end()); // back = nearest
+
+    float tHit = 0.0f;
+    const QuadNode* leaf = nullptr;
+    Rect leafRect{};
+    const Tile* hitTile = nullptr;
+    TileKey hitKey;
+    while (!stack.empty() && !leaf) {
+        Entry e = stack.back();
+        stack.pop_back();
+        auto it = pyramid[e.level].find(e.key);
+        if (it == pyramid[e.level].end() || rayPassesAbove(ray, e.t0, e.t1, it->second)) continue;
+        float cellSize = tileSize * static_cast<float>(1 << e.level);
+        Rect rect{e.key.tx * cellSize, e.key.tz * cellSize, (e.key.tx + 1) * cellSize, (e.key.tz + 1) * cellSize};
+        if (e.level == 0) {
+            auto tIt = tiles.find(e.key);
+            if (tIt == tiles.end() || !tIt->second->root) continue;
+            if (raycastNode(ray, tIt->second->root.get(), rect, e.t0, e.t1, &tHit, &leaf, &leafRect)) {
+                hitTile = tIt->second.get();
+                hitKey = e.key;
+            }
+            continue;
+        }
+        RayCandidate kids[4];
+        int count = orderChildren(ray, rect, kids);
+        for (int k = count - 1; k >= 0; --k) {
+            TileKey child{e.key.tx * 2 + (kids[k].index & 1), e.key.tz * 2 + (kids[k].index >> 1)};
+            stack.push_back({e.level - 1, child, kids[k].t0, kids[k].t1});
+        }
+    }
+    if (!leaf || !hitTile) return false;
+
+    if (out) {
+        out->distance = tHit;
+        out->x = ox + ray.dx * tHit;
+        out->y = std::min(oy + ray.dy * tHit, leaf->cell.z_mean);
+        out->z = oz + ray.dz * tHit;
+        out->tile = hitKey;
+        float leafSize = hitTile->size / static_cast<float>(std::max(hitTile->layers.side, 1));
+        int maxCell = std::max(hitTile->layers.side - 1, 0);
+        out->cellX = std::clamp(static_cast<int>((0.5f * (leafRect.minX + leafRect.maxX) - hitTile->originX) / leafSize), 0, maxCell);
+        out->cellZ = std::clamp(static_cast<int>((0.5f * (leafRect.minZ + leafRect.maxZ) - hitTile->originZ) / leafSize), 0, maxCell);
+        out->n = agedCount(*hitTile, leaf->cell.n, leaf->cell.age, agingNow());
+        out->confident = out->n >= Nconf;
+    }
+    return true;
+}
+
+bool ElevationMap::lineOfSight(float ax, float ay, float az, float bx, float by, float bz) const {
+    float dx = bx - ax, dy = by - ay, dz = bz - az;
+    float dist = std::sqrt(dx * dx + dy * dy + dz * dz);
+    if (!(dist > 0.0f)) return true;
+    return !raycast(ax, ay, az, dx, dy, dz, dist, nullptr);
+}
+
+bool ElevationMap::buildTileHeightGrid(const TileKey& key, int lod, std::vector<float>& outHeights) const {
+    lod = std::max(0, std::min(lod, maxDepth - 1));
+    auto it = tiles.find(key);
+    if (it != tiles.end()) {
+        it->second->buildHeightGridLod(gridNVertices, lod, outHeights);
+        return true;
+    }
+    auto pIt = pyramid[0].find(key);
+    if (pIt == pyramid[0].end() || pIt->second.empty()) return false;
+    int n = ((gridNVertices - 1) >> lod) + 1;
+    outHeights.assign(static_cast<size_t>(n) * static_cast<size_t>(n), pIt->second.mean);
+    return true;
+}
@@ -1,21 +1,28 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <limits>
 #include <map>
 #include <memory>
+#include <set>
+#include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "NetworkTypes.h"
+#include "ScanArena.hpp"
+#include "ScanBinning.hpp"
+#include "Traversability.hpp"
 
 struct ElevCell {
     float z_mean = 0.0f;
     float z_var = 0.0f;
     uint16_t n = 0;
     uint8_t disagreeHits = 0;
-    uint8_t age = 0;
+    uint8_t age = 0;   // low byte of the aging epoch of the last update (see CellAging)
     uint8_t flags = 0; // bitfield: 1=STABLE, 2=CHANGED, 4=DIRTY, 8=VALID
     float prev_z_mean = 0.0f;
     double lastDisagreeTs = 0.0;
@@ -38,52 +45,378 @@ struct TileKey {
     }
 };
 
+// Min/max/mean height of the valid cells under a node, tile or group of tiles.
+// Empty (min > max) when nothing below has been observed.
+struct HeightBounds {
+    float minY = std::numeric_limits<float>::infinity();
+    float maxY = -std::numeric_limits<float>::infinity();
+    float mean = 0.0f;
+    bool empty() const { return minY > maxY; }
+    bool operator==(const HeightBounds& o) const { return minY == o.minY && maxY == o.maxY && mean == o.mean; }
+    bool operator!=(const HeightBounds& o) const { return !(*this == o); }
+};
+
+// TileKey -> V map whose copies share structure, so a snapshot of it is O(1). Entries live in
+// buckets of 8x8 tiles held by shared_ptr from a shared directory; the first write after a copy
+// copies the directory and the one bucket it lands in, so keeping a copy costs O(buckets
+// written) rather than O(map). Iteration runs bucket by bucket, not in TileKey order. Writes
+// invalidate iterators.
+template <typename V>
+class SharedTileMap {
+    using Bucket = std::map<TileKey, V>;
+    using Directory = std::map<TileKey, std::shared_ptr<Bucket>>;
+    static TileKey bucketOf(const TileKey& k) { return TileKey{k.tx >> 3, k.tz >> 3}; }
+
+public:
+    class const_iterator {
+    public:
+        const std::pair<const TileKey, V>& operator*() const { return *entry; }
+        const std::pair<const TileKey, V>* operator->() const { return &*entry; }
+        const_iterator& operator++() {
+            // Buckets are never empty
+            if (++entry == bucket->second->end() && ++bucket != bucketEnd) entry = bucket->second->begin();
+            return *this;
+        }
+        bool operator==(const const_iterator& o) const {
+            return bucket == o.bucket && (bucket == bucketEnd || entry == o.entry);
+        }
+        bool operator!=(const const_iterator& o) const { return !(*this == o); }
+
+    private:
+        friend class SharedTileMap;
+        const_iterator(typename Directory::const_iterator b, typename Directory::const_iterator end,
+                       typename Bucket::const_iterator e = {})
+            : bucket(b), bucketEnd(end), entry(e) {}
+        typename Directory::const_iterator bucket, bucketEnd;
+        typename Bucket::const_iterator entry;
+    };
+
+    SharedTileMap() : dir(std::make_shared<Directory>()) {}
+
+    const_iterator begin() const {
+        return dir->empty() ? end() : const_iterator(dir->begin(), dir->end(), dir->begin()->second->begin());
+    }
+    const_iterator end() const { return const_iterator(dir->end(), dir->end()); }
+    const_iterator find(const TileKey& key) const {
+        auto b = dir->find(bucketOf(key));
+        if (b == dir->end()) return end();
+        auto e = b->second->find(key);
+        return e == b->second->end() ? end() : const_iterator(b, dir->end(), e);
+    }
+    const V& at(const TileKey& key) const { return dir->at(bucketOf(key))->at(key); }
+    size_t count(const TileKey& key) const { return find(key) != end() ? 1 : 0; }
+    size_t size() const { return entries; }
+    bool empty() const { return entries == 0; }
+
+    // Entry to write in place, nullptr if missing; copies of this map keep the old entry. A
+    // pointer value shared this way shows it in its use_count, for the pointee's own copy-on-write.
+    V* findWritable(const TileKey& key) {
+        if (find(key) == end()) return nullptr;
+        return &writableBucket(bucketOf(key)).find(key)->second;
+    }
+    // Inserts a default V if missing
+    V& operator[](const TileKey& key) {
+        auto [it, inserted] = writableBucket(bucketOf(key)).try_emplace(key);
+        if (inserted) entries++;
+        return it->second;
+    }
+    size_t erase(const TileKey& key) {
+        if (find(key) == end()) return 0;
+        const TileKey b = bucketOf(key);
+        Bucket& bucket = writableBucket(b);
+        bucket.erase(key);
+        if (bucket.empty()) dir->erase(b);
+        entries--;
+        return 1;
+    }
+    void clear() {
+        dir = std::make_shared<Directory>();
+        entries = 0;
+    }
+
+private:
+    Bucket& writableBucket(const TileKey& b) {
+        if (dir.use_count() > 1) dir = std::make_shared<Directory>(*dir);
+        std::shared_ptr<Bucket>& bucket = (*dir)[b];
+        if (!bucket) bucket = std::make_shared<Bucket>();
+        else if (bucket.use_count() > 1) bucket = std::make_shared<Bucket>(*bucket);
+        return *bucket;
+    }
+
+    std::shared_ptr<Directory> dir;
+    size_t entries = 0;
+};
+
 // Simple quadtree with fixed maximum depth. Children index order: (0: SW, 1: SE, 2: NW, 3: NE)
+// Internal nodes carry the bounds of their subtree, kept current as cells change.
 struct QuadNode {
     bool isLeaf = true;
     ElevCell cell;
+    HeightBounds bounds;
     std::unique_ptr<QuadNode> children[4];
 };
 
+// Adaptive refinement: below minDepth a leaf is split only when the ground under it is rough
+// enough to need finer cells and observed densely enough to fill them.
+struct RefinePolicy {
+    float splitVariance = 0.0025f; // z_var (m^2) above which a leaf counts as rough
+    float splitResidual = 0.10f;   // |sample - mean| (m) above which a leaf counts as rough
+    uint16_t splitSamples = 4;     // samples a leaf needs before it may split
+    int minDepth = 3;              // leaves are never coarser than this (4 m for 32 m tiles)
+};
+
+// Lazy confidence decay (ElevationMap::setAging). A cell remembers the epoch it was last
+// updated in; its sample count is halved every kEpochsPerHalfLife epochs since then, applied
+// when the cell is next read or updated rather than by sweeping the map.
+struct CellAging {
+    static constexpr uint32_t kEpochsPerHalfLife = 4;
+    bool enabled = false;
+    uint32_t epoch = 0; // current epoch
+
+    // Count left of n after `elapsed` epochs; an observed cell keeps at least 1
+    uint16_t decay(uint16_t n, uint32_t elapsed) const {
+        if (!enabled || elapsed == 0 || n <= 1) return n;
+        const uint32_t halvings = elapsed / kEpochsPerHalfLife;
+        if (halvings >= 16) return 1;
+        static constexpr uint32_t kStep[kEpochsPerHalfLife] = {256, 215, 181, 152}; // 2^(-k/4) in 1/256
+        const uint32_t r = ((static_cast<uint32_t>(n) * kStep[elapsed % kEpochsPerHalfLife]) >> 8) >> halvings;
+        return static_cast<uint16_t>(std::max<uint32_t>(r, 1));
+    }
+};
+
+enum ChangeKind : uint8_t {
+    CHANGE_APPEARED = 1u << 0, // first observation of the cell
+    CHANGE_REPLACED = 1u << 1, // old surface rejected after repeated disagreement
+    CHANGE_DRIFTED  = 1u << 2, // mean moved past the upload threshold
+};
+
+// A significant update of one cell, reported by Tile::integratePoint
+struct CellChange {
+    int cellX = 0, cellZ = 0; // leaf cell within the tile (layer coordinates)
+    float oldY = 0.0f, newY = 0.0f;
+    uint8_t kind = 0;         // ChangeKind
+};
+
+// Dense leaf-resolution mirror of a tile's cells, written through on every cell update.
+// Rows are z-major like TileUpdate heights. Batched and region queries read these instead
+// of walking the tree.
+struct CellLayers {
+    int side = 0; // cells per edge, 2^(maxDepth-1)
+    std::vector<float> height;
+    std::vector<float> variance;
+    std::vector<uint16_t> count; // sample count n; 0 = never observed
+    std::vector<uint8_t> flags;  // ElevFlags
+    std::vector<uint8_t> age;    // ElevCell::age
+    void reset(int sideCells);
+};
+
+// Traversability of a tile's leaf cells, laid out like CellLayers. Allocated on the first
+// ElevationMap::updateTraversability that reaches the tile.
+struct TraversabilityLayers {
+    int side = 0;
+    std::vector<float> slope;     // rise over run
+    std::vector<float> step;      // meters
+    std::vector<float> roughness; // meters
+    std::vector<uint8_t> cost;    // round(cost * 254), kTraversabilityUnknown without a height
+    void reset(int sideCells);
+};
+
+struct ElevationStats;
+
 struct Tile {
     // World-space origin (min corner) and size (square)
     float originX = 0.0f;
     float originZ = 0.0f;
     float size = 32.0f;
     int maxDepth = 7; // 2^7 = 128 -> 0.25 m cells for 32 m tiles
-    bool dirty = false; // mark when any cell meaningfully changes
+    // Global leaf cell of layer cell (0, 0). Points are addressed by global leaf cell,
+    // floor(x * cells per meter), and the tree path follows from its bits.
+    int cellX0 = 0, cellZ0 = 0;
+    // Set when any cell meaningfully changes; the map moves it into its own upload and
+    // checkpoint bookkeeping while it holds the only copy of the tile
+    bool dirty = false;
+    // Node counts, kept current through every split and collapse
+    uint32_t nodeCount = 0, leafCount = 0, validLeafCount = 0;
 
     std::unique_ptr<QuadNode> root;
+    CellLayers layers;
+    TraversabilityLayers traversability;
+    // Layer cells whose traversability is stale, inclusive; may reach one cell past each edge
+    // (neighbouring tiles' cells). Empty when x0 > x1. Only the integrating thread uses it.
+    int travX0 = 1, travZ0 = 1, travX1 = 0, travZ1 = 0;
+    // Aging epoch no cell was last updated before; cell ages are its low byte onwards
+    uint32_t ageBase = 0;
 
     Tile() = default;
     Tile(float ox, float oz, float s, int depth) : originX(ox), originZ(oz), size(s), maxDepth(depth) {
         root = std::make_unique<QuadNode>();
+        nodeCount = leafCount = 1;
+        layers.reset(1 << leafDepth());
+        const float cellsPerMeter = static_cast<float>(layers.side) / size;
+        cellX0 = static_cast<int>(std::lround(ox * cellsPerMeter));
+        cellZ0 = static_cast<int>(std::lround(oz * cellsPerMeter));
     }
 
-    QuadNode* locateLeaf(float x, float z);
-    void integratePoint(const LidarPoint& p, double nowTs,
+    int leafDepth() const { return maxDepth > 0 ? maxDepth - 1 : 0; }
+    // Deep copy (tree and layers), for copy-on-write
+    Tile clone() const;
+
+    // Optionally records the root-to-leaf path (at most maxDepth nodes) for bound updates.
+    // Leaves shallower than splitToDepth (default: the finest level) are split on the way.
+    QuadNode* locateLeaf(float x, float z, QuadNode** path = nullptr, int* pathLen = nullptr,
+                         int splitToDepth = -1);
+    // Returns true (and fills change, if given) when the cell changed significantly. With a
+    // refine policy, coarse leaves are split one level at a time as the policy allows.
+    bool integratePoint(const LidarPoint& p, double nowTs,
                         float tauAccept, float tauReplace,
                         int K, int Nsat, int Nconf, float tauUpload,
-                        float disagreeWindowSeconds);
+                        float disagreeWindowSeconds, CellChange* change = nullptr,
+                        const RefinePolicy* refine = nullptr, const CellAging* aging = nullptr);
+    // Overwrites the cell of the node at `depth` containing (x, z) with an externally estimated
+    // surface (fused rover layers). Leaves above that depth are split toward it and a finer
+    // subtree below it is collapsed. Returns true (and fills change) like integratePoint.
+    bool assignCell(float x, float z, int depth, float y, float variance, uint16_t n,
+                    float tauUpload, float tauReplace, CellChange* change = nullptr,
+                    const CellAging* aging = nullptr);
 
     // Builds a dense (N+1)x(N+1) height grid covering the tile by sampling leaf z_mean.
     void buildHeightGrid(int gridNVertices, std::vector<float>& outHeights) const;
+    // Same, but samples subtree means `lod` levels above the leaves (grid shrinks by 2^lod).
+    void buildHeightGridLod(int gridNVertices, int lod, std::vector<float>& outHeights) const;
+
+    void markTraversabilityStale(int x0, int z0, int x1, int z1);
+    bool traversabilityStale() const { return travX0 <= travX1 && travZ0 <= travZ1; }
+
+    // Epoch a cell was last updated in, from its age byte
+    uint32_t cellEpoch(uint8_t age) const {
+        return ageBase + static_cast<uint8_t>(age - static_cast<uint8_t>(ageBase));
+    }
+    // Applies pending decay to every cell and restamps them at aging.epoch. Needed once the
+    // tile is written 128+ epochs past ageBase, so age bytes never wrap.
+    void rebaseAges(const CellAging& aging);
+
+    HeightBounds bounds() const { return root ? root->bounds : HeightBounds{}; }
+    // This tile's share of the map statistics, from the maintained counters
+    ElevationStats stats() const;
+    // Recomputes every node's bounds bottom-up (after deserializing).
+    void rebuildBounds();
+    // Recounts nodes from the tree (after deserializing).
+    void recountNodes();
+    // Refills the dense cell layers from the leaves (after deserializing).
+    void rebuildLayers();
+
+    // Pre-order flattening of the tree (one tag byte per node, packed cell per populated leaf)
+    void serialize(std::vector<uint8_t>& out) const;
+    bool deserialize(const uint8_t* data, size_t size);
+
+private:
+    void cellChanged(QuadNode** path, int pathLen, float x, float z);
+    void leafCellOf(float x, float z, int* lx, int* lz) const;
+    QuadNode* splitLeafToward(QuadNode* leaf, float x, float z, QuadNode** path, int* pathLen);
+    QuadNode* nodeAtDepth(float x, float z, int depth, QuadNode** path, int* pathLen);
+    // locateLeaf for a leaf depth given as std::integral_constant (common geometries) or int
+    template <typename LeafDepth>
+    QuadNode* locateLeafAt(LeafDepth leafDepthC, float x, float z, QuadNode** path, int* pathLen,
+                           int splitToDepth);
+    void writeLayerBlock(const ElevCell& c, int bx, int bz, int block);
+    void refreshAge(ElevCell& c, const CellAging* aging);
 };
 
+class TileStore; // fwd
+
 struct TileUpdate {
     TileKey key;
     std::vector<float> heights; // (N+1)^2 heights row-major (z-major rows), Y-up
     float tileSize = 32.0f;
 };
 
+// Read-only strided view of one cell layer: element (i, j) is data[j * stride + i]
+template <typename T>
+struct LayerView {
+    const T* data = nullptr;
+    size_t stride = 0; // elements between rows (z)
+    const T& at(int i, int j) const { return data[static_cast<size_t>(j) * stride + static_cast<size_t>(i)]; }
+    const T* row(int j) const { return data + static_cast<size_t>(j) * stride; }
+};
+
+// Leaf cells covering a rectangle, from ElevationMap::extractRegion. Inside a single tile the
+// layer views point straight into the tile and stay valid until the map is next modified;
+// regions crossing tile seams are stitched into the view's own buffers.
+struct RegionView {
+    float originX = 0.0f, originZ = 0.0f; // min corner of cell (0, 0)
+    float cellSize = 0.0f;
+    int cols = 0, rows = 0;               // cells in x and z
+    bool stitched = false;
+    LayerView<float> height;
+    LayerView<float> variance;
+    LayerView<uint16_t> count;
+    LayerView<uint8_t> flags;
+
+    RegionView() = default;
+    RegionView(const RegionView&) = delete;
+    RegionView& operator=(const RegionView&) = delete;
+    RegionView(RegionView&&) = default;
+    RegionView& operator=(RegionView&&) = default;
+
+private:
+    friend class ElevationMap;
+    std::vector<float> heightBuf, varianceBuf;
+    std::vector<uint16_t> countBuf;
+    std::vector<uint8_t> flagsBuf;
+};
+
+// Terrain change from ElevationMap::consumeChanges. Repeated changes of a cell between two
+// consumes fold into one event (first oldY, last newY). When more events are pending than the
+// capacity allows, the tiles with the most events each collapse into one region event over
+// their bounding cells; once every tile is down to one event, events merge into region events
+// over blocks of 2x2, 4x4, ... tiles. No change is ever dropped, only described more coarsely.
+struct ChangeEvent {
+    TileKey tile;                   // first tile (lowest tx, tz) of a block region
+    int tileSpan = 1;               // region: tiles per block edge, a power of two
+    int cellX0 = 0, cellZ0 = 0, cellX1 = 0, cellZ1 = 0; // inclusive, layer coordinates of `tile`;
+                                                        // a block region runs on into the next tiles
+    float oldY = 0.0f, newY = 0.0f; // region: means over the folded changes
+    float maxDelta = 0.0f;          // largest |newY - oldY| folded in
+    uint32_t merged = 1;            // changes folded into this event
+    uint8_t kind = 0;               // ChangeKind bits, OR-ed
+    bool region = false;
+    double timestamp = 0.0;         // of the latest change
+    uint16_t rover = 0;             // source of the latest change (ElevationMap::changeRoverName)
+};
+
+// Result of ElevationMap::raycast
+struct RayHit {
+    float x = 0.0f, y = 0.0f, z = 0.0f; // hit point
+    float distance = 0.0f;              // along the (normalized) ray
+    TileKey tile;
+    int cellX = 0, cellZ = 0;           // leaf cell within the tile (layer coordinates)
+    uint16_t n = 0;                     // sample count of the hit cell, after aging
+    bool confident = false;             // n >= Nconf
+};
+
+// Map statistics, maintained as tiles change so getStats is O(1). Byte counts are the
+// allocated sizes of the main structures, not every heap block.
 struct ElevationStats {
-    size_t numTiles = 0;
+    size_t numTiles = 0;        // resident
     size_t numLeaves = 0;
+    size_t numValidCells = 0;   // leaves with a height
+    size_t numDirtyTiles = 0;   // waiting for consumeDirtyTiles
+    size_t numSpilledTiles = 0; // tiles held only by the tile store
+    size_t storeBytes = 0;
+    size_t treeBytes = 0;           // quadtree nodes
+    size_t layerBytes = 0;          // dense cell layers
+    size_t traversabilityBytes = 0; // traversability layers
+    size_t roverLayerBytes = 0;     // rover contribution tiles and fusion baselines
+    size_t changeBytes = 0;         // pending change events
+    size_t allocatedBytes = 0;      // running total allocated for the structures above
+    // What evicting tiles can free: everything above except the change events and the store
+    size_t residentBytes() const { return treeBytes + layerBytes + traversabilityBytes + roverLayerBytes; }
 };
 
 class ElevationMap {
 public:
     ElevationMap();
+    ~ElevationMap();
 
     void setParameters(float tileSizeMeters,
                        float baseCellResolutionMeters,
@@ -95,7 +428,58 @@ public:
                        float tauUploadMeters,
                        float deltaT_windowSeconds);
 
-    void integrateScan(const std::vector<LidarPoint>& points, double nowTs);
+    void integrateScan(const std::vector<LidarPoint>& points, double nowTs,
+                       const std::string& roverId = std::string());
+
+    // Adaptive refinement (off by default): leaves stop splitting on smooth or sparsely seen
+    // ground, so node count follows terrain complexity rather than covered area.
+    void setAdaptiveRefinement(bool enable, const RefinePolicy& policy = RefinePolicy()) {
+        adaptiveRefine = enable;
+        refinePolicy = policy;
+    }
+
+    // Per-rover contribution layers (off by default). Each rover keeps its own estimate of every
+    // cell it observed, in sparse tiles on the map's tile grid at the scan aggregation resolution
+    // (~1 m). A fusion pass combines the rovers' estimates of the touched cells by confidence
+    // (count over variance) and writes the result into the map, so a calibration offset between
+    // two rovers settles into a weighted mean instead of replacing the cell back and forth. A
+    // rover's confirmed surface still replaces estimates that were last seen before it appeared.
+    // While enabled, integrateScan goes through the rover's layer and fuses immediately, and
+    // fused cells are written at the layer resolution (adaptive refinement does not apply).
+    void setRoverLayers(bool enable) { roverLayersEnabled = enable; }
+    bool getRoverLayers() const { return roverLayersEnabled; }
+    // Registers a rover's layer and returns its index. Setup only: not concurrent with accumulateScan.
+    int addRoverLayer(const std::string& roverId);
+    // Index of a registered rover layer, or -1
+    int roverLayerIndex(const std::string& roverId) const;
+    // Integrates a scan into one rover's layer without touching the map. Calls for different
+    // layers touch disjoint memory and may run concurrently, but not alongside any other call.
+    void accumulateScan(int layer, const std::vector<LidarPoint>& points, double nowTs);
+    // Fuses every layer cell touched since the last call into the map; returns cells written.
+    size_t fuseRoverLayers(double nowTs);
+
+    // Confidence decay (off by default): a cell's sample count halves every halfLifeSeconds it
+    // goes without observations, so old saturated cells yield to real terrain change and report
+    // low confidence once stale. Decay is applied lazily when a cell is read or updated. Uses
+    // the map's own clock, so it also holds across rovers whose scan clocks differ. 0 disables.
+    void setAging(float halfLifeSeconds);
+    float getAgingHalfLife() const { return agingEpochSeconds * CellAging::kEpochsPerHalfLife; }
+
+    // Immutable view of the map for readers on other threads, in O(1). Tiles and the pyramid
+    // are shared copy-on-write (see SharedTileMap): the writer copies a tile before changing it
+    // while any snapshot still holds it, so a snapshot never changes under its readers and
+    // keeping one costs what changed since. Call from the thread that integrates; the snapshot
+    // answers const queries only and reads spilled tiles through the shared store.
+    std::shared_ptr<const ElevationMap> snapshot() const;
+
+    // Moves out the change events recorded since the last call (see ChangeEvent).
+    std::vector<ChangeEvent> consumeChanges();
+    // Pending cell events before tiles collapse into region events (0 disables recording). At
+    // least 8: the coarsest block merge can leave four events.
+    void setChangeCapacity(size_t maxEvents) { changeCapacity = maxEvents ? std::max<size_t>(maxEvents, 8) : 0; }
+    // Rover id or name passed to integrateScan for ChangeEvent::rover; empty for unknown ids
+    const std::string& changeRoverName(uint16_t id) const;
+    size_t pendingChangeCount() const { return changes.size(); }
 
     // Returns dirty tiles with fully rebuilt height grids and clears their dirty flags.
     std::vector<TileUpdate> consumeDirtyTiles();
@@ -111,6 +495,78 @@ public:
     // its sample count is considered confident (n >= Nconf).
     bool getGroundAt(float x, float z, float* outY, uint16_t* outN = nullptr) const;
 
+    // Batched getGroundAt. Points are binned to leaf cells in a branch-free loop, grouped by
+    // tile (one directory lookup per tile) and resolved from the dense cell layers. outOk[i]
+    // matches getGroundAt's result, outN[i] is 0 where nothing was observed, and outY[i] is
+    // only written where a cell exists. outNormals (optional, xyz per point) are taken from the
+    // bilinear patch of the surrounding cell centers; (0,1,0) where unknown.
+    void getGroundAtBatch(const float* xs, const float* zs, size_t count,
+                          float* outY, uint16_t* outN, uint8_t* outOk,
+                          float* outNormals = nullptr) const;
+
+    // Height bounds over an XZ rectangle from the coarsest pyramid levels that fit, descending
+    // into tiles only where the rectangle cuts through them. Spilled tiles contribute their
+    // whole-tile bounds. Returns false if nothing inside has been observed.
+    bool getHeightBounds(float minX, float minZ, float maxX, float maxZ, HeightBounds* out) const;
+    // Leaf-cell layers (height, variance, count, flags) over an XZ rectangle, snapped outward to
+    // cell boundaries. Counts are as last written, before aging. Zero-copy when the rectangle lies within one tile; cells of missing
+    // tiles read as unobserved. Returns false for an empty rectangle.
+    bool extractRegion(float minX, float minZ, float maxX, float maxZ, RegionView* out) const;
+
+    // First intersection of a ray with the map, treating each leaf cell as a column up to its
+    // mean height. Descends the height pyramid and tile quadtrees front to back and skips any
+    // region the ray passes above. dir need not be normalized; only resident tiles are hit.
+    bool raycast(float ox, float oy, float oz, float dx, float dy, float dz,
+                 float maxDist, RayHit* out) const;
+    // True if nothing in the map blocks the segment between the two points.
+    bool lineOfSight(float ax, float ay, float az, float bx, float by, float bz) const;
+    // Traversability (slope, step height, roughness and their combined cost) per leaf cell.
+    // Heights that change mark their cell and its neighbours stale, across tile seams too;
+    // updateTraversability recomputes only stale cells, so it can run after every scan.
+    void setTraversabilityPolicy(const TraversabilityPolicy& policy);
+    const TraversabilityPolicy& getTraversabilityPolicy() const { return travPolicy; }
+    // Recomputes stale cells of resident tiles, tile by tile until about maxCells were done.
+    // Returns the number of cells computed.
+    size_t updateTraversability(size_t maxCells = std::numeric_limits<size_t>::max());
+    // Traversability at (x,z) as of the last update. False if the cell has no height or its
+    // tile has not been computed yet.
+    bool getTraversabilityAt(float x, float z, TraversabilityCell* out) const;
+    // Bounds of an aggregate cell covering 2^level x 2^level tiles (level 0 = one tile).
+    bool getPyramidBounds(int level, int cx, int cz, HeightBounds* out) const;
+    // Coarse height grid of a tile for overview rendering: ((N-1) >> lod) + 1 vertices per side.
+    // Spilled tiles come back flat at their mean height.
+    bool buildTileHeightGrid(const TileKey& key, int lod, std::vector<float>& outHeights) const;
+    static constexpr int kPyramidLevels = 8; // level 7 aggregates 128x128 tiles
+
+    // Bound the resident tile set by spilling tiles to a memory-mapped file. Call after
+    // setParameters. Tiles are faulted back in when integration touches them again;
+    // const queries only see resident tiles. With restoreExisting, a matching file from a
+    // previous run is indexed in place and its tiles are reported through consumeDirtyTiles.
+    bool enableTileStore(const std::string& path, size_t maxResidentTiles,
+                         bool restoreExisting = false, bool compress = true);
+    // Writes back and drops the tiles farthest from all anchors (XZ) while over the limit.
+    void evictDistantTiles(const std::vector<std::pair<float, float>>& anchorsXZ);
+    // Also evict while ElevationStats::residentBytes exceeds this (0 = no byte limit). Needs the tile store.
+    void setMemoryBudget(size_t bytes) { memoryBudget = bytes; }
+    size_t getMemoryBudget() const { return memoryBudget; }
+    // Reports these tiles through consumeDirtyTiles again, e.g. after the renderer dropped them.
+    // Spilled tiles are faulted back in for it; unknown keys are ignored.
+    void requestTileUploads(const std::vector<TileKey>& keys);
+    // Queues up to maxTiles changed tiles for the store's background writer (checkpoint).
+    size_t checkpointDirtyTiles(size_t maxTiles);
+    // Checkpoints everything and waits for the writer, e.g. before exit.
+    void flushTileStore();
+
+    // Keys of every tile the map holds, resident or spilled, in TileKey order.
+    std::vector<TileKey> tileKeys() const;
+    // Leaf cells per tile edge (the side of copyTileHeights).
+    int getTileCells() const { return 1 << std::max(maxDepth - 1, 0); }
+    // Leaf-cell heights of one tile, z-major, NaN where unobserved. Spilled tiles are read from
+    // the tile store, so a snapshot sees them too (as stored now, possibly newer than the
+    // snapshot), and several threads may call this on the same snapshot. False if the map holds
+    // no such tile.
+    bool copyTileHeights(const TileKey& key, std::vector<float>& out) const;
+
 private:
     float tileSize = 32.0f;
     float baseCellRes = 0.25f;
@@ -125,11 +581,104 @@ private:
     float disagreeWindow = 1.0f; // seconds
 
     int gridNVertices = 129; // default for 0.25m cells over 32m tile
+    bool adaptiveRefine = false;
+    RefinePolicy refinePolicy;
+
+    // Rover contribution layers; each owns its sparse tiles, pending cells and scan scratch
+    struct ContributionTile;
+    struct RoverLayer;
+    bool roverLayersEnabled = false;
+    int contribDepth = 5; // tree depth of a contribution cell, derived in setParameters
+    uint32_t fuseEpoch = 1; // fusion passes so far; orders observations across rovers
+    std::vector<std::unique_ptr<RoverLayer>> roverLayers;
+    std::map<std::string, int> roverLayerIds;
+    // Map contents a tile held before its first fusion (restored or faulted in), fused as one
+    // more contributor; a null entry marks a tile that started empty
+    std::map<TileKey, std::unique_ptr<ContributionTile>> fusionBaseline;
+    size_t baselineBytes = 0;
+    struct PendingFuse {
+        TileKey key;
+        uint32_t cell;
+        int layer;
+    };
+    std::vector<PendingFuse> fusePending;
+
+    float agingEpochSeconds = 0.0f; // 0 = no aging
+    std::map<TileKey, uint32_t> spilledAgeBase; // Tile::ageBase of tiles evicted to the store
+
+    TraversabilityPolicy travPolicy;
+    // Padded height/validity window for updateTraversability, reused across tiles
+    std::vector<float> travHeights, travValid;
+
+    // Per-scan scratch for integrateScan, kept to reuse its storage
+    ScanBins scanBins;
+    std::vector<std::pair<uint64_t, uint32_t>> scanOrder;
+    std::vector<float> scanYs;
+
+    // Shared with snapshots; never modify a tile reached through here without getOrCreateTile,
+    // which copies it first if a snapshot still holds it
+    SharedTileMap<std::shared_ptr<Tile>> tiles;
+
+    // Totals over resident tiles, updated with each change to one (see accountTile)
+    ElevationStats totals;
+
+    // Snapshots share the store to read spilled tiles; only the writer saves or evicts
+    std::shared_ptr<TileStore> store;
+    size_t residentStored = 0;   // storedResident.size(), kept for snapshots
+    // Writer-side tile bookkeeping, off the tiles so tiles shared with a snapshot never change:
+    // resident tiles waiting for upload, changed since their last save, held by the store too
+    std::set<TileKey> uploadPending;
+    std::set<TileKey> checkpointPending;
+    std::set<TileKey> storedResident;
+    size_t maxResidentTiles = 0; // 0 = unbounded
+    size_t memoryBudget = 0;     // resident bytes, 0 = unbounded
+    std::vector<TileKey> restoredPending; // restored tiles not yet handed to the renderer
+
+    // Per-level bounds of tile groups; level 0 survives eviction, so coarse queries never fault tiles in
+    std::vector<SharedTileMap<HeightBounds>> pyramid;
 
-    std::map<TileKey, Tile> tiles;
+    // Pending change events; cells index by global leaf cell, region events by (level, block
+    // key) where level is log2 of their tile span
+    std::vector<ChangeEvent> changes;
+    std::unordered_map<uint64_t, uint32_t> changeIndex;
+    std::map<std::pair<int, TileKey>, uint32_t> regionIndex;
+    int coarsestChange = 0; // highest level in regionIndex
+    size_t changeCapacity = 4096;
+    // Change sources by ChangeEvent::rover
+    std::vector<std::string> changeRovers;
+    std::map<std::string, uint16_t> changeRoverIds;
 
     static double nowSeconds();
+    // getGroundAtBatch for a leaf depth given as std::integral_constant (common geometries) or int
+    template <typename LeafDepth>
+    void getGroundAtBatchAt(LeafDepth leafDepthC, const float* xs, const float* zs, size_t count,
+                            float* outY, uint16_t* outN, uint8_t* outOk, float* outNormals) const;
+    CellAging agingNow() const;
+    // Sample count of a cell (count and age as stored) after decay up to aging.epoch
+    uint16_t agedCount(const Tile& t, uint16_t n, uint8_t age, const CellAging& aging) const;
     Tile& getOrCreateTile(int tx, int tz);
+    // Writes a resident tile back to the store and drops it with its rover contributions
+    void evictTile(const TileKey& key);
+    // Keys of `tiles`, for loops that write tiles (writes invalidate iterators)
+    std::vector<TileKey> residentKeys() const;
+    void markForUpload(const TileKey& key);
+    // Moves Tile::dirty into uploadPending and checkpointPending; tile must come from getOrCreateTile
+    void takeTileChanges(const TileKey& key, Tile& tile);
+    // Folds the change of a tile's stats into the totals (empty stats for added/removed tiles)
+    void accountTile(const ElevationStats& before, const ElevationStats& after);
+    void emitRestored(size_t maxTiles, std::vector<TileUpdate>& updates);
+    void updatePyramid(const TileKey& key, const HeightBounds& b);
+    // Pushes the bounds of the tiles an update touched up the pyramid (sorts/dedups touched)
+    void propagateTileBounds(ScratchVector<TileKey>& touched);
+    ContributionTile* captureBaseline(const TileKey& key, Tile& tile);
+    void recordChange(const TileKey& key, const CellChange& c, double ts, uint16_t rover);
+    uint16_t changeRoverId(const std::string& rover);
+    void collapseChanges(const std::set<TileKey>& keys);
+    // Merges the events finer than 2^level tiles per block edge (see ChangeEvent)
+    void mergeChangeBlocks(int level);
+    // Frees an eighth of the change capacity (see ChangeEvent)
+    void makeRoomForChanges();
+    void reindexChanges();
 };
 
 
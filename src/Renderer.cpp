@@ -16,6 +16,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "QuadtreeMap.hpp"
+#include "PoseEstimator.hpp"
 
 static const char* kVS = R"GLSL(
 #version 330 core
@@ -144,6 +145,7 @@ bool Renderer::init(){
   glBindVertexArray(pointVao);
   glBindBuffer(GL_ARRAY_BUFFER, pointVbo);
   glBufferData(GL_ARRAY_BUFFER, 1, nullptr, GL_DYNAMIC_DRAW);
+  noteBufferData(pointVboBytes, 1);
   glEnableVertexAttribArray(0);
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float)*3, (void*)0);
   glBindVertexArray(0);
@@ -244,6 +246,9 @@ void Renderer::shutdown(){
     if (kv.second.vao) glDeleteVertexArrays(1, &kv.second.vao);
   }
   gpuTiles.clear();
+  evictedTiles.clear();
+  gpuMemory.liveBytes = 0;
+  pointVboBytes = sharedEboBytes = 0;
   pointVbo = pointVao = prog = 0;
 }
 
@@ -251,48 +256,19 @@ void Renderer::resize(int width, int height){
   viewportWidth = width; viewportHeight = height;
 }
 
-void Renderer::updateRoverState(const std::string& roverId, const PosePacket& pose){
-  auto& st = rovers[roverId];
-  glm::vec3 newPos = {pose.posX, pose.posY, pose.posZ};
-  glm::vec3 newRot = {pose.rotXdeg, pose.rotYdeg, pose.rotZdeg};
-  // Alpha-Beta (g-h) filter for position and yaw (prediction + correction)
-  double ts = pose.timestamp;
-  double dt = (st.kfInitialized && st.lastPoseTs > 0.0) ? std::max(1e-3, ts - st.lastPoseTs) : 0.1;
-  st.lastPoseTs = ts;
-  const float g = 0.25f;  // position gain
-  const float h = 0.6f;   // velocity gain
-  const float gYaw = 0.25f, hYaw = 0.6f;
-  if (!st.kfInitialized) {
-    st.kfPos = newPos;
-    st.kfVel = glm::vec3(0.0f);
-    st.kfYawDeg = newRot.y;
-    st.kfYawRateDeg = 0.0f;
-    st.kfInitialized = true;
-  } else {
-    // Predict
-    st.kfPos += st.kfVel * static_cast<float>(dt);
-    st.kfYawDeg += st.kfYawRateDeg * static_cast<float>(dt);
-    // Normalize yaw to [-180,180]
-    auto normYaw = [](float yaw){ while (yaw > 180.f) yaw -= 360.f; while (yaw < -180.f) yaw += 360.f; return yaw; };
-    st.kfYawDeg = normYaw(st.kfYawDeg);
-    float measYaw = normYaw(newRot.y);
-    // Innovation
-    glm::vec3 r = newPos - st.kfPos;
-    float ryaw = normYaw(measYaw - st.kfYawDeg);
-    // Correct
-    st.kfPos += g * r;
-    st.kfVel += (h / static_cast<float>(dt)) * r;
-    st.kfYawDeg = normYaw(st.kfYawDeg + gYaw * ryaw);
-    st.kfYawRateDeg += (hYaw / static_cast<float>(dt)) * ryaw;
+void Renderer::syncRoverPoses(){
+  if (!poseEstimator) return;
+  for (auto& kv : rovers) {
+    auto& st = kv.second;
+    if (st.poseIndex < 0) st.poseIndex = poseEstimator->indexOf(kv.first);
+    PoseEstimate est;
+    if (!poseEstimator->latest(st.poseIndex, est)) continue;
+    st.position = {est.posX, est.posY, est.posZ};
+    st.rotationDeg = {est.rotXdeg, est.rotYdeg, est.rotZdeg};
+    st.smoothedPosition = {est.smoothX, est.smoothY, est.smoothZ};
+    st.smoothedRotationDeg = {est.smoothRotXdeg, est.smoothRotYdeg, est.smoothRotZdeg};
+    st.noiseScore = est.noiseScore;
   }
-  st.smoothedPosition = st.kfPos;
-  st.smoothedRotationDeg = {newRot.x, st.kfYawDeg, newRot.z};
-  // Update noise score as EMA of instantaneous displacement magnitude
-  float inst = glm::length(newPos - st.position);
-  const float alphaNoise = 0.1f;
-  st.noiseScore = (1.0f - alphaNoise) * st.noiseScore + alphaNoise * inst;
-  st.position = newPos;
-  st.rotationDeg = newRot;
 }
 
 void Renderer::setRoverColor(const std::string& roverId, const glm::vec3& color){
@@ -314,6 +290,7 @@ void Renderer::renderFrame(const std::vector<LidarPoint>& globalTerrain, float f
 
   // Draw terrain if any
   drawTerrain();
+  syncRoverPoses();
 
   glUseProgram(prog);
   int locP = glGetUniformLocation(prog, "uProj");
@@ -342,6 +319,7 @@ void Renderer::renderFrame(const std::vector<LidarPoint>& globalTerrain, float f
     glBindBuffer(GL_ARRAY_BUFFER, pointVbo);
     if (!globalTerrain.empty()) {
       glBufferData(GL_ARRAY_BUFFER, globalTerrain.size() * sizeof(LidarPoint), globalTerrain.data(), GL_DYNAMIC_DRAW);
+      noteBufferData(pointVboBytes, globalTerrain.size() * sizeof(LidarPoint));
       glUniform1f(locS, 2.0f);
       glUniform3f(locC, 0.8f, 0.85f, 0.9f);
       glUniform1i(locUse, 0);
@@ -403,21 +381,45 @@ void Renderer::renderFrame(const std::vector<LidarPoint>& globalTerrain, float f
   float dtSec = (fps > 1e-3f) ? (1.0f / fps) : 0.016f;
   // Draw each rover as a larger cube placed slightly above the ground, oriented to terrain normal, with a red nose
   if (!rovers.empty()) {
+    // Resolve ground height and normal for every rover in one batched query
+    bool haveBatch = false;
+    if (groundBatchSampler) {
+      size_t count = rovers.size();
+      groundQueryX.resize(count); groundQueryZ.resize(count); groundQueryY.resize(count);
+      groundQueryN.assign(count, 0); groundQueryOk.assign(count, 0);
+      groundQueryNormals.resize(count * 3);
+      size_t qi = 0;
+      for (const auto& kv : rovers) {
+        groundQueryX[qi] = kv.second.smoothedPosition.x;
+        groundQueryZ[qi] = kv.second.smoothedPosition.z;
+        groundQueryY[qi] = kv.second.smoothedPosition.y;
+        ++qi;
+      }
+      groundBatchSampler(groundQueryX.data(), groundQueryZ.data(), count, groundQueryY.data(),
+                         groundQueryN.data(), groundQueryOk.data(),
+                         alignToTerrain ? groundQueryNormals.data() : nullptr);
+      haveBatch = true;
+    }
+    size_t roverIndex = 0;
     glBindVertexArray(roverMeshVao);
-    for (const auto& kv : rovers) {
+    for (auto& kv : rovers) {
       const auto& st = kv.second;
+      const size_t ri = roverIndex++;
       // Bigger body
       const glm::vec3 baseScale = glm::vec3(3.2f, 1.4f, 2.4f);
       float yawRad = glm::radians(st.smoothedRotationDeg.y);
 
       // Always follow ground with symmetric rate limiting; no physics and no popping
-      auto& mut = rovers[kv.first];
+      auto& mut = kv.second;
       glm::vec3 center = mut.smoothedPosition;
       // Prefer confident elevation map sample directly for stability; fallback to local estimate
       float groundY = mut.smoothedPosition.y;
       uint16_t nconf = 0;
       bool okSample = false;
-      if (groundSampler) {
+      if (haveBatch) {
+        okSample = groundQueryOk[ri] != 0;
+        if (okSample) { groundY = groundQueryY[ri]; nconf = groundQueryN[ri]; }
+      } else if (groundSampler) {
         float ytmp = groundY; uint16_t ntmp = 0;
         okSample = groundSampler(mut.smoothedPosition.x, mut.smoothedPosition.z, ytmp, ntmp);
         if (okSample) { groundY = ytmp; nconf = ntmp; }
@@ -458,7 +460,12 @@ void Renderer::renderFrame(const std::vector<LidarPoint>& globalTerrain, float f
       glm::vec3 n = up;
       if (alignToTerrain) {
         bool haveNormal = false;
-        if (groundSampler) {
+        if (haveBatch) {
+          if (groundQueryOk[ri]) {
+            n = glm::vec3(groundQueryNormals[ri * 3], groundQueryNormals[ri * 3 + 1], groundQueryNormals[ri * 3 + 2]);
+            haveNormal = true;
+          }
+        } else if (groundSampler) {
           float step = 0.75f; // meters
           float yL, yR, yD, yU; uint16_t tmp;
           bool okL = groundSampler(center.x - step, center.z, yL, tmp);
@@ -491,7 +498,7 @@ void Renderer::renderFrame(const std::vector<LidarPoint>& globalTerrain, float f
       basis[1] = glm::vec4(n, 0.0f);
       basis[2] = glm::vec4(fwdT, 0.0f);
       // apply local model offset (Right, Up, Forward) in aligned basis
-      glm::vec3 off = rovers.at(kv.first).modelOffsetLocal;
+      glm::vec3 off = st.modelOffsetLocal;
       glm::vec3 worldOff = right * off.x + n * off.y + fwdT * off.z;
       model = glm::translate(model, worldOff) * basis;
       model = glm::scale(model, baseScale);
@@ -568,7 +575,7 @@ void Renderer::ensureTerrainPipeline(int gridNVertices){
   if (terrainGridN == gridNVertices && sharedEbo != 0) return;
   // Rebuild shared index buffer for a grid made of (gridN-1)x(gridN-1) quads
   terrainGridN = gridNVertices;
-  if (sharedEbo) { glDeleteBuffers(1, &sharedEbo); sharedEbo = 0; }
+  if (sharedEbo) { glDeleteBuffers(1, &sharedEbo); sharedEbo = 0; noteBufferData(sharedEboBytes, 0); }
   std::vector<unsigned int> indices;
   int N = gridNVertices;
   indices.reserve((N-1)*(N-1)*6);
@@ -586,6 +593,7 @@ void Renderer::ensureTerrainPipeline(int gridNVertices){
   glGenBuffers(1, &sharedEbo);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sharedEbo);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size()*sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+  noteBufferData(sharedEboBytes, indices.size()*sizeof(unsigned int));
 }
 
 void Renderer::uploadDirtyTiles(const std::vector<TileUpdate>& updates){
@@ -596,6 +604,7 @@ void Renderer::uploadDirtyTiles(const std::vector<TileUpdate>& updates){
   for (const auto& up : updates) {
     long long key = (static_cast<long long>(up.key.tx) << 32) ^ (static_cast<unsigned long long>(up.key.tz) & 0xffffffffull);
     TileGpu &gpu = gpuTiles[key];
+    evictedTiles.erase(key);
     if (gpu.vao == 0) {
       glGenVertexArrays(1, &gpu.vao);
       glGenBuffers(1, &gpu.vbo);
@@ -603,6 +612,7 @@ void Renderer::uploadDirtyTiles(const std::vector<TileUpdate>& updates){
       glBindVertexArray(gpu.vao);
       glBindBuffer(GL_ARRAY_BUFFER, gpu.vbo);
       glBufferData(GL_ARRAY_BUFFER, sizeof(VN) * N * N, nullptr, GL_DYNAMIC_DRAW);
+      noteBufferData(gpu.bytes, sizeof(VN) * N * N);
       glEnableVertexAttribArray(0);
       glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VN), (void*)0);
       glEnableVertexAttribArray(1);
@@ -655,6 +665,7 @@ void Renderer::uploadDirtyTiles(const std::vector<TileUpdate>& updates){
     }
     glBindBuffer(GL_ARRAY_BUFFER, gpu.vbo);
     glBufferData(GL_ARRAY_BUFFER, verts.size()*sizeof(VN), verts.data(), GL_DYNAMIC_DRAW);
+    noteBufferData(gpu.bytes, verts.size()*sizeof(VN));
     gpu.tx = up.key.tx; gpu.tz = up.key.tz;
     // Update global observed range
     if (std::isfinite(localMinY)) observedMinY = std::min(observedMinY, localMinY);
@@ -664,7 +675,59 @@ void Renderer::uploadDirtyTiles(const std::vector<TileUpdate>& updates){
   }
 }
 
+void Renderer::noteBufferData(size_t& held, size_t bytes){
+  gpuMemory.liveBytes += bytes - held;
+  gpuMemory.allocatedBytes += bytes;
+  held = bytes;
+}
+
+void Renderer::enforceGpuBudget(){
+  if (gpuBudget == 0 || gpuMemory.liveBytes <= gpuBudget) return;
+  // Down to a low-water mark, so each tile coming into view does not push another one out
+  const size_t target = gpuBudget - gpuBudget / 8;
+  std::vector<std::pair<float, long long>> byDistance;
+  byDistance.reserve(gpuTiles.size());
+  for (const auto &kv : gpuTiles) {
+    float dx = (kv.second.tx + 0.5f) * kv.second.tileSize - lastCamPos.x;
+    float dz = (kv.second.tz + 0.5f) * kv.second.tileSize - lastCamPos.z;
+    byDistance.emplace_back(dx*dx + dz*dz, kv.first);
+  }
+  std::sort(byDistance.begin(), byDistance.end(), [](const auto& a, const auto& b){ return a.first > b.first; });
+  for (const auto &entry : byDistance) {
+    if (gpuMemory.liveBytes <= target) break;
+    auto it = gpuTiles.find(entry.second);
+    TileGpu &gpu = it->second;
+    if (gpu.vbo) glDeleteBuffers(1, &gpu.vbo);
+    if (gpu.vao) glDeleteVertexArrays(1, &gpu.vao);
+    noteBufferData(gpu.bytes, 0);
+    evictedTiles[entry.second] = EvictedTile{gpu.tx, gpu.tz, gpu.tileSize};
+    gpuTiles.erase(it);
+  }
+}
+
+void Renderer::takeTilesToReload(size_t maxTiles, std::vector<TileKey>& out){
+  // Same low-water mark as enforceGpuBudget, so reloads never trigger evictions
+  const size_t target = gpuBudget - gpuBudget / 8;
+  const size_t perTile = sizeof(float) * 6 * static_cast<size_t>(terrainGridN) * static_cast<size_t>(terrainGridN);
+  size_t expected = gpuMemory.liveBytes;
+  const float maxDist2 = terrainDrawDistance * terrainDrawDistance;
+  for (auto it = evictedTiles.begin(); it != evictedTiles.end() && maxTiles > 0;) {
+    if (gpuBudget > 0 && expected + perTile > target) break;
+    const EvictedTile &ev = it->second;
+    float dx = (ev.tx + 0.5f) * ev.tileSize - lastCamPos.x;
+    float dz = (ev.tz + 0.5f) * ev.tileSize - lastCamPos.z;
+    if (dx*dx + dz*dz > maxDist2) { ++it; continue; }
+    out.push_back(TileKey{ev.tx, ev.tz});
+    expected += perTile;
+    --maxTiles;
+    it = evictedTiles.erase(it);
+  }
+}
+
 void Renderer::drawTerrain(){
+  glm::mat4 invView = glm::inverse(viewM);
+  lastCamPos = glm::vec3(invView[3].x, invView[3].y, invView[3].z);
+  enforceGpuBudget();
   if (gpuTiles.empty() || terrainProg == 0) return;
   glUseProgram(terrainProg);
   int locP = glGetUniformLocation(terrainProg, "uProj");
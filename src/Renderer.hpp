@@ -7,9 +7,12 @@
 
 #include <glm/glm.hpp>
 
+#include "MemoryMonitor.hpp"
 #include "NetworkTypes.h"
 
+struct TileKey; // fwd
 struct TileUpdate; // fwd
+class PoseEstimator; // fwd
 
 struct RoverVisualState {
 	glm::vec3 position {0.0f};
@@ -26,14 +29,8 @@ struct RoverVisualState {
 	bool initialized = false;
 	float groundYFiltered = 0.0f;
 	float lastRenderCenterY = 0.0f;
-
-	// Alpha-Beta (g-h) filter state for pose
-	bool kfInitialized = false;
-	glm::vec3 kfPos {0.0f};
-	glm::vec3 kfVel {0.0f};
-	float kfYawDeg = 0.0f;
-	float kfYawRateDeg = 0.0f;
-	double lastPoseTs = 0.0;
+	// Index of this rover in the pose estimator (-1 until resolved)
+	int poseIndex = -1;
 };
 
 class Renderer {
@@ -43,7 +40,8 @@ public:
 
 	void resize(int width, int height);
 
-	void updateRoverState(const std::string& roverId, const PosePacket& pose);
+	// Rover poses are read from the estimator once per frame (render thread only; never written here)
+	void setPoseEstimator(const PoseEstimator* estimator) { poseEstimator = estimator; }
 	void setRoverColor(const std::string& roverId, const glm::vec3& color);
 	void setRoverModelOffset(const std::string& roverId, const glm::vec3& localOffsetRUF);
 
@@ -81,6 +79,16 @@ public:
 	void uploadDirtyTiles(const std::vector<TileUpdate>& updates);
 	void drawTerrain();
 
+	// GPU memory of the terrain tile vertex buffers, the shared index buffer and the point buffer;
+	// allocatedBytes counts every glBufferData to them
+	MemoryUsage getGpuMemoryUsage() const { return gpuMemory; }
+	// Over budget, drawTerrain drops the tile buffers farthest from the camera (0 = unlimited)
+	void setGpuMemoryBudget(size_t bytes) { gpuBudget = bytes; }
+	size_t getGpuMemoryBudget() const { return gpuBudget; }
+	// Up to maxTiles dropped tiles that are back within the draw distance and fit the budget
+	// again; pass them to ElevationMap::requestTileUploads
+	void takeTilesToReload(size_t maxTiles, std::vector<TileKey>& out);
+
 	// Toggle whether rovers align to terrain (height and normal). When false,
 	// rovers are rendered at their smoothed pose position/orientation only.
 	void setAlignToTerrain(bool enabled) { alignToTerrain = enabled; }
@@ -88,6 +96,10 @@ public:
 
 	// Provide elevation map sampling hook for grounding
 	void setGroundSampler(std::function<bool(float,float,float&,uint16_t&)> sampler) { groundSampler = std::move(sampler); }
+	// Batched hook: (xs, zs, count, outY, outN, outOk, outNormals or null). When set, all rovers are
+	// grounded with one call per frame instead of per-rover point samples.
+	using GroundBatchSampler = std::function<void(const float*, const float*, size_t, float*, uint16_t*, uint8_t*, float*)>;
+	void setGroundBatchSampler(GroundBatchSampler sampler) { groundBatchSampler = std::move(sampler); }
 
 private:
 	unsigned int pointVbo = 0;
@@ -109,12 +121,19 @@ private:
 	float terrainDrawDistance = 1200.0f;
 
 	std::map<std::string, RoverVisualState> rovers;
+	const PoseEstimator* poseEstimator = nullptr;
+	void syncRoverPoses();
 
 	unsigned int createShaderProgram();
 	glm::mat4 viewM {1.0f};
 	glm::mat4 projM {1.0f};
 
 	std::function<bool(float,float,float&,uint16_t&)> groundSampler;
+	GroundBatchSampler groundBatchSampler;
+	// Per-frame batch query scratch (one entry per rover)
+	std::vector<float> groundQueryX, groundQueryZ, groundQueryY, groundQueryNormals;
+	std::vector<uint16_t> groundQueryN;
+	std::vector<uint8_t> groundQueryOk;
 
 	// Terrain grid
 	struct TileGpu {
@@ -126,9 +145,24 @@ private:
 		float tileSize = 32.0f;
 		float minY = std::numeric_limits<float>::infinity();
 		float maxY = -std::numeric_limits<float>::infinity();
+		size_t bytes = 0; // vertex buffer
 	};
 	// key: (tx,tz) packed
 	std::map<long long, TileGpu> gpuTiles;
+	// Tiles whose buffers were dropped for the GPU budget, same keys
+	struct EvictedTile {
+		int tx = 0, tz = 0;
+		float tileSize = 32.0f;
+	};
+	std::map<long long, EvictedTile> evictedTiles;
+	MemoryUsage gpuMemory;
+	size_t gpuBudget = 0;
+	size_t pointVboBytes = 0;
+	size_t sharedEboBytes = 0;
+	glm::vec3 lastCamPos {0.0f};
+	// Buffer storage of `held` bytes re-specified with `bytes`
+	void noteBufferData(size_t& held, size_t bytes);
+	void enforceGpuBudget();
 	unsigned int terrainProg = 0;
 	unsigned int sharedEbo = 0;
 	int terrainGridN = 0;
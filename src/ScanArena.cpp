@@ -0,0 +1,33 @@
+#include "ScanArena.hpp"
+
+#include <algorithm>
+
+ScanArena& ScanArena::local() {
+    thread_local ScanArena arena;
+    return arena;
+}
+
+void* ScanArena::allocate(size_t bytes, size_t align) {
+    // Blocks come from new[], aligned for any fundamental type; offsets keep the requested alignment
+    while (current < blocks.size()) {
+        Block& b = blocks[current];
+        const size_t offset = (used + align - 1) & ~(align - 1);
+        if (offset <= b.size && bytes <= b.size - offset) {
+            used = offset + bytes;
+            return b.data.get() + offset;
+        }
+        // Skip to the next block; what is left of this one stays unused until a rewind
+        current++;
+        used = 0;
+    }
+    size_t size = std::max(kMinBlockBytes, bytes);
+    if (!blocks.empty()) size = std::max(size, blocks.back().size * 2);
+    Block b;
+    b.data.reset(new unsigned char[size]);
+    b.size = size;
+    blocks.push_back(std::move(b));
+    reserved += size;
+    current = blocks.size() - 1;
+    used = bytes;
+    return blocks.back().data.get();
+}
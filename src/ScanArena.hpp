@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Per-thread monotonic arena for scan-scoped temporaries. Allocation bumps an offset within
+// the current block and nothing is freed on its own; a Scope rewinds the arena to where it
+// stood when the scope opened, so the next scan reuses the same blocks without touching the
+// heap. New blocks are only allocated while the high-water mark still grows.
+class ScanArena {
+public:
+    ScanArena() = default;
+    ScanArena(const ScanArena&) = delete;
+    ScanArena& operator=(const ScanArena&) = delete;
+
+    // The calling thread's arena
+    static ScanArena& local();
+
+    void* allocate(size_t bytes, size_t align);
+    // Bytes held in blocks (the high-water mark, rounded up to whole blocks)
+    size_t capacity() const { return reserved; }
+
+    // Rewinds the arena on destruction. Scopes nest; memory allocated inside one must not be
+    // used after it closes.
+    class Scope {
+    public:
+        explicit Scope(ScanArena& a = ScanArena::local()) : arena(a), block(a.current), used(a.used) {}
+        ~Scope() {
+            arena.current = block;
+            arena.used = used;
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        ScanArena& arena;
+        size_t block, used;
+    };
+
+private:
+    static constexpr size_t kMinBlockBytes = size_t(1) << 20;
+    struct Block {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size = 0;
+    };
+    std::vector<Block> blocks;
+    size_t current = 0; // block being filled
+    size_t used = 0;    // bytes of it in use
+    size_t reserved = 0;
+};
+
+// Standard allocator over the calling thread's arena. deallocate is a no-op; containers using
+// it must not outlive the innermost ScanArena::Scope that was open when they allocated.
+template <typename T>
+struct ArenaAllocator {
+    using value_type = T;
+    ScanArena* arena;
+
+    ArenaAllocator() : arena(&ScanArena::local()) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
+
+template <typename T>
+using ScratchVector = std::vector<T, ArenaAllocator<T>>;
+
+template <typename K, typename V>
+using ScratchHashMap = std::unordered_map<K, V, std::hash<K>, std::equal_to<K>, ArenaAllocator<std::pair<const K, V>>>;
@@ -0,0 +1,159 @@
+#include "ScanBinning.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SCANBIN_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(SCANBIN_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SCANBIN_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SCANBIN_TARGET(isa)
+#endif
+
+void ScanBins::resize(size_t n) {
+    x.resize(n); y.resize(n); z.resize(n);
+    cellX.resize(n); cellZ.resize(n);
+    tileX.resize(n); tileZ.resize(n);
+    cellKey.resize(n);
+}
+
+namespace {
+using BinKernel = void (*)(const LidarPoint*, size_t, size_t, float, float, ScanBins&);
+
+// Points [begin, count); the SIMD kernels finish their tail with this
+void binScalar(const LidarPoint* pts, size_t begin, size_t count, float invCell, float invTile, ScanBins& out) {
+    for (size_t i = begin; i < count; ++i) {
+        const LidarPoint& p = pts[i];
+        out.x[i] = p.x; out.y[i] = p.y; out.z[i] = p.z;
+        int32_t cx = floorToInt(p.x * invCell), cz = floorToInt(p.z * invCell);
+        out.cellX[i] = cx; out.cellZ[i] = cz;
+        out.tileX[i] = floorToInt(p.x * invTile); out.tileZ[i] = floorToInt(p.z * invTile);
+        out.cellKey[i] = packCellKey(cx, cz);
+    }
+}
+
+#ifdef SCANBIN_X86
+SCANBIN_TARGET("sse4.1")
+void binSse41(const LidarPoint* pts, size_t begin, size_t count, float invCell, float invTile, ScanBins& out) {
+    const __m128 vCell = _mm_set1_ps(invCell);
+    const __m128 vTile = _mm_set1_ps(invTile);
+    const __m128i bias = _mm_set1_epi32(static_cast<int>(0x80000000u));
+    size_t i = begin;
+    for (; i + 4 <= count; i += 4) {
+        const LidarPoint* p = pts + i;
+        __m128 x = _mm_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x);
+        __m128 y = _mm_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y);
+        __m128 z = _mm_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z);
+        _mm_storeu_ps(&out.x[i], x);
+        _mm_storeu_ps(&out.y[i], y);
+        _mm_storeu_ps(&out.z[i], z);
+        __m128i cx = _mm_cvttps_epi32(_mm_floor_ps(_mm_mul_ps(x, vCell)));
+        __m128i cz = _mm_cvttps_epi32(_mm_floor_ps(_mm_mul_ps(z, vCell)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.cellX[i]), cx);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.cellZ[i]), cz);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.tileX[i]), _mm_cvttps_epi32(_mm_floor_ps(_mm_mul_ps(x, vTile))));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.tileZ[i]), _mm_cvttps_epi32(_mm_floor_ps(_mm_mul_ps(z, vTile))));
+        // (cz, cx) pairs read as little-endian 64-bit keys
+        __m128i bx = _mm_xor_si128(cx, bias), bz = _mm_xor_si128(cz, bias);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.cellKey[i]), _mm_unpacklo_epi32(bz, bx));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.cellKey[i + 2]), _mm_unpackhi_epi32(bz, bx));
+    }
+    binScalar(pts, i, count, invCell, invTile, out);
+}
+
+SCANBIN_TARGET("avx2")
+void binAvx2(const LidarPoint* pts, size_t begin, size_t count, float invCell, float invTile, ScanBins& out) {
+    const __m256 vCell = _mm256_set1_ps(invCell);
+    const __m256 vTile = _mm256_set1_ps(invTile);
+    const __m256i bias = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+    // Stride-3 gather offsets for the packed x, y, z fields
+    const __m256i stride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    size_t i = begin;
+    for (; i + 8 <= count; i += 8) {
+        const float* base = &pts[i].x;
+        __m256 x = _mm256_i32gather_ps(base, stride, 4);
+        __m256 y = _mm256_i32gather_ps(base + 1, stride, 4);
+        __m256 z = _mm256_i32gather_ps(base + 2, stride, 4);
+        _mm256_storeu_ps(&out.x[i], x);
+        _mm256_storeu_ps(&out.y[i], y);
+        _mm256_storeu_ps(&out.z[i], z);
+        __m256i cx = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(x, vCell)));
+        __m256i cz = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(z, vCell)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out.cellX[i]), cx);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out.cellZ[i]), cz);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out.tileX[i]), _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(x, vTile))));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out.tileZ[i]), _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(z, vTile))));
+        // Unpack works per 128-bit lane: lo = keys 0,1,4,5 and hi = keys 2,3,6,7
+        __m256i bx = _mm256_xor_si256(cx, bias), bz = _mm256_xor_si256(cz, bias);
+        __m256i lo = _mm256_unpacklo_epi32(bz, bx);
+        __m256i hi = _mm256_unpackhi_epi32(bz, bx);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out.cellKey[i]), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out.cellKey[i + 4]), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    binScalar(pts, i, count, invCell, invTile, out);
+}
+
+bool cpuHas(const char* isa) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    if (isa[0] == 'a') return __builtin_cpu_supports("avx2");
+    return __builtin_cpu_supports("sse4.1");
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    bool osAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+    if (isa[0] != 'a') return sse41;
+    if (!osAvx || maxLeaf < 7) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    (void)isa;
+    return false;
+#endif
+}
+#endif
+
+struct Dispatch {
+    BinKernel kernel = binScalar;
+    const char* name = "scalar";
+    bool avx2 = false;
+    Dispatch() {
+#ifdef SCANBIN_X86
+        if (cpuHas("avx2")) {
+            kernel = binAvx2;
+            name = "avx2";
+            avx2 = true;
+        } else if (cpuHas("sse4.1")) {
+            kernel = binSse41;
+            name = "sse4.1";
+        }
+#endif
+    }
+};
+
+const Dispatch& dispatch() {
+    static const Dispatch d;
+    return d;
+}
+}
+
+void binScanPoints(const LidarPoint* pts, size_t count, float cellSize, float tileSize, ScanBins& out) {
+    out.resize(count);
+    if (count == 0) return;
+    dispatch().kernel(pts, 0, count, 1.0f / cellSize, 1.0f / tileSize, out);
+}
+
+const char* binningKernelName() {
+    return dispatch().name;
+}
+
+bool cpuSupportsAvx2() {
+    return dispatch().avx2;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "NetworkTypes.h"
+
+// Per-point binning of a scan in structure-of-arrays form: the points deinterleaved plus the
+// grid cell and tile each falls into. The kernel is picked once per process from the CPU
+// (AVX2, SSE4.1 or scalar); all variants give identical results.
+struct ScanBins {
+    std::vector<float> x, y, z;
+    std::vector<int32_t> cellX, cellZ; // floor(p * (1 / cellSize))
+    std::vector<int32_t> tileX, tileZ; // floor(p * (1 / tileSize))
+    // Cell index packed so that unsigned order matches (cellX, cellZ) order; sorts into rows
+    std::vector<uint64_t> cellKey;
+
+    void resize(size_t n);
+    size_t size() const { return x.size(); }
+};
+
+inline int32_t floorToInt(float v) {
+    int32_t i = static_cast<int32_t>(v);
+    return i - static_cast<int32_t>(v < static_cast<float>(i));
+}
+
+// Murmur3 finalizer for open-addressed tables keyed by packed cells: every key bit reaches
+// the low bits used for the slot
+inline uint64_t hashCellKey(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDull;
+    return key ^ (key >> 33);
+}
+
+inline uint64_t packCellKey(int32_t cx, int32_t cz) {
+    // Biasing by 2^31 makes unsigned order match signed order
+    return (static_cast<uint64_t>(static_cast<uint32_t>(cx) ^ 0x80000000u) << 32) |
+           (static_cast<uint32_t>(cz) ^ 0x80000000u);
+}
+
+// Bins count points into out (resized, storage reused across calls).
+void binScanPoints(const LidarPoint* pts, size_t count, float cellSize, float tileSize, ScanBins& out);
+
+// Name of the kernel binScanPoints dispatches to ("avx2", "sse4.1" or "scalar").
+const char* binningKernelName();
+
+// CPU check shared with the other runtime-dispatched kernels (x86 with OS support for AVX2).
+bool cpuSupportsAvx2();
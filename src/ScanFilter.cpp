@@ -0,0 +1,188 @@
+#include "ScanFilter.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr uint32_t kNoColumn = 0xFFFFFFFFu;
+constexpr size_t kColumnGrain = 256;
+constexpr size_t kMaxBlockSample = 64;
+}
+
+OutlierFilter::OutlierFilter(unsigned threads) {
+    if (threads == 0) {
+        unsigned hw = std::thread::hardware_concurrency();
+        threads = std::max(1u, std::min(4u, hw / 2));
+    }
+    scratch.resize(threads);
+    for (unsigned w = 1; w < threads; ++w) workers.emplace_back(&OutlierFilter::runWorker, this, w);
+}
+
+OutlierFilter::~OutlierFilter() {
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        stopping = true;
+    }
+    workCv.notify_all();
+    for (auto& t : workers) {
+        if (t.joinable()) t.join();
+    }
+}
+
+size_t OutlierFilter::filterScans(std::vector<CompletedScan>& scans) {
+    size_t removed = 0;
+    for (auto& sc : scans) removed += filter(sc.points);
+    return removed;
+}
+
+size_t OutlierFilter::filter(std::vector<LidarPoint>& points) {
+    const size_t n = points.size();
+    if (n == 0) return 0;
+    binScanPoints(points.data(), n, policy.cellSize, policy.cellSize, bins);
+
+    // Hash points into columns: at most one column per point, so 2n slots keeps probes short
+    size_t capacity = 16;
+    while (capacity < 2 * n) capacity <<= 1;
+    table.assign(capacity, 0);
+    tableMask = capacity - 1;
+    columns.clear();
+    pointColumn.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t key = bins.cellKey[i];
+        uint64_t slot = hashCellKey(key) & tableMask;
+        while (table[slot] != 0 && columns[table[slot] - 1].key != key) slot = (slot + 1) & tableMask;
+        if (table[slot] == 0) {
+            columns.push_back(Column{key, bins.cellX[i], bins.cellZ[i], 0, 0});
+            table[slot] = static_cast<uint32_t>(columns.size());
+        }
+        const uint32_t id = table[slot] - 1;
+        columns[id].count++;
+        pointColumn[i] = id;
+    }
+    // Counting sort of the heights into their columns
+    uint32_t offset = 0;
+    for (Column& col : columns) {
+        col.start = offset;
+        offset += col.count;
+        col.count = 0;
+    }
+    colYs.resize(n);
+    colPoints.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        Column& col = columns[pointColumn[i]];
+        const uint32_t at = col.start + col.count++;
+        colYs[at] = bins.y[i];
+        colPoints[at] = static_cast<uint32_t>(i);
+    }
+
+    keep.assign(n, 1);
+    parallelFor(columns.size(), kColumnGrain,
+                [this](size_t worker, size_t begin, size_t end) { testColumns(worker, begin, end); });
+
+    size_t kept = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (keep[i]) points[kept++] = points[i];
+    }
+    points.resize(kept);
+    seen.fetch_add(n, std::memory_order_relaxed);
+    rejected.fetch_add(n - kept, std::memory_order_relaxed);
+    return n - kept;
+}
+
+uint32_t OutlierFilter::findColumn(uint64_t key) const {
+    uint64_t slot = hashCellKey(key) & tableMask;
+    while (table[slot] != 0) {
+        const uint32_t id = table[slot] - 1;
+        if (columns[id].key == key) return id;
+        slot = (slot + 1) & tableMask;
+    }
+    return kNoColumn;
+}
+
+void OutlierFilter::testColumns(size_t worker, size_t begin, size_t end) {
+    WorkerScratch& s = scratch[worker];
+    uint32_t block[9];
+    for (size_t c = begin; c < end; ++c) {
+        const Column& col = columns[c];
+        int blockLen = 0;
+        size_t total = 0;
+        for (int dz = -1; dz <= 1; ++dz) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                uint32_t id = (dx == 0 && dz == 0) ? static_cast<uint32_t>(c)
+                                                   : findColumn(packCellKey(col.cx + dx, col.cz + dz));
+                if (id == kNoColumn) continue;
+                block[blockLen++] = id;
+                total += columns[id].count;
+            }
+        }
+        // Too little support to judge: keep[] defaults to keep
+        if (total < static_cast<size_t>(policy.minNeighbors)) continue;
+        // Dense blocks are strided down so the cost per column stays bounded
+        const size_t stride = (total + kMaxBlockSample - 1) / kMaxBlockSample;
+        s.ys.clear();
+        size_t phase = 0;
+        for (int b = 0; b < blockLen; ++b) {
+            const Column& nb = columns[block[b]];
+            for (uint32_t k = nb.start + static_cast<uint32_t>(phase); k < nb.start + nb.count;
+                 k += static_cast<uint32_t>(stride)) {
+                s.ys.push_back(colYs[k]);
+            }
+            phase = (phase + stride - nb.count % stride) % stride;
+        }
+        const size_t mid = s.ys.size() / 2;
+        std::nth_element(s.ys.begin(), s.ys.begin() + mid, s.ys.end());
+        const float median = s.ys[mid];
+        s.dev.resize(s.ys.size());
+        for (size_t k = 0; k < s.ys.size(); ++k) s.dev[k] = std::fabs(s.ys[k] - median);
+        std::nth_element(s.dev.begin(), s.dev.begin() + mid, s.dev.end());
+        const float sigma = std::max(1.4826f * s.dev[mid], policy.minSigma);
+        const float bound = policy.kSigma * sigma;
+        for (uint32_t k = col.start; k < col.start + col.count; ++k) {
+            if (std::fabs(colYs[k] - median) > bound) keep[colPoints[k]] = 0;
+        }
+    }
+}
+
+void OutlierFilter::parallelFor(size_t count, size_t grain,
+                                const std::function<void(size_t, size_t, size_t)>& fn) {
+    if (workers.empty() || count <= grain) {
+        fn(0, 0, count);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        job = &fn;
+        jobCount = count;
+        jobGrain = grain;
+        nextChunk.store(0, std::memory_order_relaxed);
+        busyWorkers = workers.size();
+        ++generation;
+    }
+    workCv.notify_all();
+    // The calling thread works as worker 0
+    for (size_t b = nextChunk.fetch_add(grain); b < count; b = nextChunk.fetch_add(grain)) {
+        fn(0, b, std::min(b + grain, count));
+    }
+    std::unique_lock<std::mutex> lk(mutex);
+    doneCv.wait(lk, [&] { return busyWorkers == 0; });
+    job = nullptr;
+}
+
+void OutlierFilter::runWorker(size_t worker) {
+    uint64_t lastGeneration = 0;
+    std::unique_lock<std::mutex> lk(mutex);
+    while (true) {
+        workCv.wait(lk, [&] { return stopping || generation != lastGeneration; });
+        if (stopping) break;
+        lastGeneration = generation;
+        const auto* fn = job;
+        const size_t count = jobCount;
+        const size_t grain = jobGrain;
+        lk.unlock();
+        for (size_t b = nextChunk.fetch_add(grain); b < count; b = nextChunk.fetch_add(grain)) {
+            (*fn)(worker, b, std::min(b + grain, count));
+        }
+        lk.lock();
+        if (--busyWorkers == 0) doneCv.notify_one();
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "DataAssembler.hpp"
+#include "ScanBinning.hpp"
+
+// Statistical outlier rejection for a scan before it reaches ElevationMap.
+// Points are hashed into vertical columns (cellSize edge in XZ). Each point is tested
+// against the heights in its own and the 8 surrounding columns: it is dropped when it sits
+// more than kSigma robust sigmas (1.4826 * MAD, floored at minSigma) from that block's
+// median height. Blocks with fewer than minNeighbors points pass untested, so sparse
+// scans lose nothing; the map's replacement confirmation still guards those.
+struct OutlierPolicy {
+    float cellSize = 1.0f;
+    int minNeighbors = 6;
+    float kSigma = 2.5f;
+    float minSigma = 0.25f;
+};
+
+class OutlierFilter {
+public:
+    // threads = 0 picks from the hardware; the calling thread always takes part
+    explicit OutlierFilter(unsigned threads = 0);
+    ~OutlierFilter();
+    OutlierFilter(const OutlierFilter&) = delete;
+    OutlierFilter& operator=(const OutlierFilter&) = delete;
+
+    void setPolicy(const OutlierPolicy& p) { policy = p; }
+    const OutlierPolicy& getPolicy() const { return policy; }
+
+    // Removes rejected points in place, keeping the order of the rest. Returns the number removed.
+    size_t filter(std::vector<LidarPoint>& points);
+    size_t filterScans(std::vector<CompletedScan>& scans);
+
+    // Running totals; safe to read from any thread
+    uint64_t pointsSeen() const { return seen.load(std::memory_order_relaxed); }
+    uint64_t pointsRejected() const { return rejected.load(std::memory_order_relaxed); }
+
+private:
+    struct Column {
+        uint64_t key;
+        int32_t cx, cz;
+        uint32_t start, count; // range in colYs / colPoints
+    };
+    struct WorkerScratch {
+        std::vector<float> ys;
+        std::vector<float> dev;
+    };
+
+    uint32_t findColumn(uint64_t key) const;
+    void testColumns(size_t worker, size_t begin, size_t end);
+    // Runs fn(worker, begin, end) over [0, count) in chunks on the pool and the calling thread
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t, size_t)>& fn);
+    void runWorker(size_t worker);
+
+    OutlierPolicy policy;
+    std::atomic<uint64_t> seen{0};
+    std::atomic<uint64_t> rejected{0};
+
+    // Per-scan state, reused across scans
+    ScanBins bins;
+    std::vector<uint32_t> table;    // open-addressed column ids + 1, 0 = empty
+    uint64_t tableMask = 0;
+    std::vector<Column> columns;
+    std::vector<uint32_t> pointColumn;
+    std::vector<float> colYs;       // point heights grouped by column
+    std::vector<uint32_t> colPoints; // point indices grouped by column
+    std::vector<uint8_t> keep;
+    std::vector<WorkerScratch> scratch;
+
+    // Worker pool
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable workCv;
+    std::condition_variable doneCv;
+    bool stopping = false;
+    uint64_t generation = 0;
+    size_t busyWorkers = 0;
+    const std::function<void(size_t, size_t, size_t)>* job = nullptr;
+    size_t jobCount = 0;
+    size_t jobGrain = 1;
+    std::atomic<size_t> nextChunk{0};
+};
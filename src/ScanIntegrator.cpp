@@ -0,0 +1,88 @@
+#include "ScanIntegrator.hpp"
+
+#include <algorithm>
+
+ScanIntegrator::ScanIntegrator(unsigned threads) {
+    if (threads == 0) {
+        unsigned hw = std::thread::hardware_concurrency();
+        threads = std::max(1u, std::min(4u, hw / 2));
+    }
+    for (unsigned w = 1; w < threads; ++w) workers.emplace_back(&ScanIntegrator::runWorker, this);
+}
+
+ScanIntegrator::~ScanIntegrator() {
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        stopping = true;
+    }
+    workCv.notify_all();
+    for (auto& t : workers) {
+        if (t.joinable()) t.join();
+    }
+}
+
+size_t ScanIntegrator::integrateScans(ElevationMap& map, const std::vector<CompletedScan>& scans) {
+    for (size_t j = 0; j < jobCount; ++j) jobSlot[static_cast<size_t>(jobs[j].layer)] = 0;
+    jobCount = 0;
+    size_t layered = 0;
+    double newestTs = 0.0;
+    for (const auto& sc : scans) {
+        newestTs = std::max(newestTs, sc.timestamp);
+        const int layer = map.roverLayerIndex(sc.roverId);
+        if (layer < 0) {
+            map.integrateScan(sc.points, sc.timestamp, sc.roverId);
+            continue;
+        }
+        const size_t li = static_cast<size_t>(layer);
+        if (li >= jobSlot.size()) jobSlot.resize(li + 1, 0);
+        if (jobSlot[li] == 0) {
+            if (jobCount == jobs.size()) jobs.emplace_back();
+            jobs[jobCount].layer = layer;
+            jobs[jobCount].scans.clear();
+            jobSlot[li] = static_cast<uint32_t>(++jobCount);
+        }
+        jobs[jobSlot[li] - 1].scans.push_back(&sc);
+        ++layered;
+    }
+    if (jobCount == 0) return 0;
+
+    // Layers touch disjoint memory, so each job runs alone; the fusion pass does not
+    jobMap = &map;
+    nextJob.store(0, std::memory_order_relaxed);
+    if (workers.empty() || jobCount == 1) {
+        runJobs();
+    } else {
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            busyWorkers = workers.size();
+            ++generation;
+        }
+        workCv.notify_all();
+        runJobs();
+        std::unique_lock<std::mutex> lk(mutex);
+        doneCv.wait(lk, [&] { return busyWorkers == 0; });
+    }
+    jobMap = nullptr;
+    map.fuseRoverLayers(newestTs);
+    return layered;
+}
+
+void ScanIntegrator::runJobs() {
+    for (size_t j = nextJob.fetch_add(1); j < jobCount; j = nextJob.fetch_add(1)) {
+        for (const CompletedScan* sc : jobs[j].scans) jobMap->accumulateScan(jobs[j].layer, sc->points, sc->timestamp);
+    }
+}
+
+void ScanIntegrator::runWorker() {
+    uint64_t lastGeneration = 0;
+    std::unique_lock<std::mutex> lk(mutex);
+    while (true) {
+        workCv.wait(lk, [&] { return stopping || generation != lastGeneration; });
+        if (stopping) break;
+        lastGeneration = generation;
+        lk.unlock();
+        runJobs();
+        lk.lock();
+        if (--busyWorkers == 0) doneCv.notify_one();
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "DataAssembler.hpp"
+#include "QuadtreeMap.hpp"
+
+// Last stage between DataAssembler and ElevationMap. Scans from rovers with a contribution
+// layer are grouped by layer and accumulated on a persistent worker pool, one job per layer
+// per pass, then fused once; scans from other rovers are integrated directly, in order.
+class ScanIntegrator {
+public:
+    // threads = 0 picks from the hardware; the calling thread always takes part
+    explicit ScanIntegrator(unsigned threads = 0);
+    ~ScanIntegrator();
+    ScanIntegrator(const ScanIntegrator&) = delete;
+    ScanIntegrator& operator=(const ScanIntegrator&) = delete;
+
+    // Returns the number of scans that went through a rover layer
+    size_t integrateScans(ElevationMap& map, const std::vector<CompletedScan>& scans);
+
+private:
+    struct LayerJob {
+        int layer = -1;
+        std::vector<const CompletedScan*> scans;
+    };
+
+    void runJobs();
+    void runWorker();
+
+    // Per-pass jobs, reused across passes; jobSlot maps a layer index to its job + 1
+    std::vector<LayerJob> jobs;
+    size_t jobCount = 0;
+    std::vector<uint32_t> jobSlot;
+    ElevationMap* jobMap = nullptr;
+
+    // Worker pool
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable workCv;
+    std::condition_variable doneCv;
+    bool stopping = false;
+    uint64_t generation = 0;
+    size_t busyWorkers = 0;
+    std::atomic<size_t> nextJob{0};
+};
@@ -0,0 +1,259 @@
+#include "ScanRegistration.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "ScanBinning.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SCANREG_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(SCANREG_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SCANREG_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SCANREG_TARGET(isa)
+#endif
+
+namespace {
+constexpr double kRadToDeg = 180.0 / 3.14159265358979323846;
+
+// Accumulator layout: H00 H01 H02 H03 H11 H12 H13 H22 H23 H33 | b0 b1 b2 b3 | cost | matches.
+// Parameters are (dx, dy, dz, yaw); the residual is r = y - h(x', z') with Jacobian
+// J = (-gx, 1, -gz, gz * ax - gx * az), where (ax, az) is the rotated offset from the pivot.
+constexpr int kAccumulators = 16;
+
+struct ResidualSoA {
+    const float* r;
+    const float* gx;
+    const float* gz;
+    const float* ax;
+    const float* az;
+    const float* mask;
+};
+
+void accumulateScalar(const ResidualSoA& in, size_t begin, size_t count, float delta, float maxRes, float* acc) {
+    for (size_t i = begin; i < count; ++i) {
+        const float r = in.r[i];
+        const float absr = std::fabs(r);
+        const bool valid = in.mask[i] != 0.0f && absr <= maxRes;
+        const float w = valid ? std::min(1.0f, delta / std::max(absr, 1e-12f)) : 0.0f;
+        const float j0 = -in.gx[i], j2 = -in.gz[i];
+        const float j3 = in.gz[i] * in.ax[i] - in.gx[i] * in.az[i];
+        const float wj0 = w * j0, wj2 = w * j2, wj3 = w * j3;
+        acc[0] += wj0 * j0; acc[1] += wj0; acc[2] += wj0 * j2; acc[3] += wj0 * j3;
+        acc[4] += w; acc[5] += wj2; acc[6] += wj3;
+        acc[7] += wj2 * j2; acc[8] += wj2 * j3; acc[9] += wj3 * j3;
+        acc[10] += wj0 * r; acc[11] += w * r; acc[12] += wj2 * r; acc[13] += wj3 * r;
+        acc[14] += w * r * r;
+        acc[15] += valid ? 1.0f : 0.0f;
+    }
+}
+
+#ifdef SCANREG_X86
+SCANREG_TARGET("avx2")
+void accumulateAvx2(const ResidualSoA& in, size_t count, float delta, float maxRes, float* acc) {
+    __m256 a[kAccumulators];
+    for (int k = 0; k < kAccumulators; ++k) a[k] = _mm256_setzero_ps();
+    const __m256 vDelta = _mm256_set1_ps(delta);
+    const __m256 vMax = _mm256_set1_ps(maxRes);
+    const __m256 vTiny = _mm256_set1_ps(1e-12f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 r = _mm256_loadu_ps(in.r + i);
+        const __m256 gx = _mm256_loadu_ps(in.gx + i);
+        const __m256 gz = _mm256_loadu_ps(in.gz + i);
+        const __m256 absr = _mm256_andnot_ps(sign, r);
+        const __m256 valid = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(in.mask + i), zero, _CMP_NEQ_OQ),
+                                           _mm256_cmp_ps(absr, vMax, _CMP_LE_OQ));
+        const __m256 w = _mm256_and_ps(valid, _mm256_min_ps(one, _mm256_div_ps(vDelta, _mm256_max_ps(absr, vTiny))));
+        const __m256 j0 = _mm256_xor_ps(gx, sign);
+        const __m256 j2 = _mm256_xor_ps(gz, sign);
+        const __m256 j3 = _mm256_sub_ps(_mm256_mul_ps(gz, _mm256_loadu_ps(in.ax + i)),
+                                        _mm256_mul_ps(gx, _mm256_loadu_ps(in.az + i)));
+        const __m256 wj0 = _mm256_mul_ps(w, j0), wj2 = _mm256_mul_ps(w, j2), wj3 = _mm256_mul_ps(w, j3);
+        a[0] = _mm256_add_ps(a[0], _mm256_mul_ps(wj0, j0));
+        a[1] = _mm256_add_ps(a[1], wj0);
+        a[2] = _mm256_add_ps(a[2], _mm256_mul_ps(wj0, j2));
+        a[3] = _mm256_add_ps(a[3], _mm256_mul_ps(wj0, j3));
+        a[4] = _mm256_add_ps(a[4], w);
+        a[5] = _mm256_add_ps(a[5], wj2);
+        a[6] = _mm256_add_ps(a[6], wj3);
+        a[7] = _mm256_add_ps(a[7], _mm256_mul_ps(wj2, j2));
+        a[8] = _mm256_add_ps(a[8], _mm256_mul_ps(wj2, j3));
+        a[9] = _mm256_add_ps(a[9], _mm256_mul_ps(wj3, j3));
+        a[10] = _mm256_add_ps(a[10], _mm256_mul_ps(wj0, r));
+        a[11] = _mm256_add_ps(a[11], _mm256_mul_ps(w, r));
+        a[12] = _mm256_add_ps(a[12], _mm256_mul_ps(wj2, r));
+        a[13] = _mm256_add_ps(a[13], _mm256_mul_ps(wj3, r));
+        a[14] = _mm256_add_ps(a[14], _mm256_mul_ps(_mm256_mul_ps(w, r), r));
+        a[15] = _mm256_add_ps(a[15], _mm256_and_ps(valid, one));
+    }
+    alignas(32) float lanes[8];
+    for (int k = 0; k < kAccumulators; ++k) {
+        _mm256_store_ps(lanes, a[k]);
+        for (float v : lanes) acc[k] += v;
+    }
+    accumulateScalar(in, i, count, delta, maxRes, acc);
+}
+#endif
+
+void accumulate(const ResidualSoA& in, size_t count, float delta, float maxRes, float* acc) {
+    std::fill(acc, acc + kAccumulators, 0.0f);
+#ifdef SCANREG_X86
+    if (cpuSupportsAvx2()) {
+        accumulateAvx2(in, count, delta, maxRes, acc);
+        return;
+    }
+#endif
+    accumulateScalar(in, 0, count, delta, maxRes, acc);
+}
+
+// Solves the symmetric positive definite 4x4 system A x = b in place (Cholesky)
+bool solve4(double A[4][4], double b[4], double x[4]) {
+    double L[4][4] = {};
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j <= i; ++j) {
+            double s = A[i][j];
+            for (int k = 0; k < j; ++k) s -= L[i][k] * L[j][k];
+            if (i == j) {
+                if (s <= 1e-12) return false;
+                L[i][i] = std::sqrt(s);
+            } else {
+                L[i][j] = s / L[j][j];
+            }
+        }
+    }
+    double y[4];
+    for (int i = 0; i < 4; ++i) {
+        double s = b[i];
+        for (int k = 0; k < i; ++k) s -= L[i][k] * y[k];
+        y[i] = s / L[i][i];
+    }
+    for (int i = 3; i >= 0; --i) {
+        double s = y[i];
+        for (int k = i + 1; k < 4; ++k) s -= L[k][i] * x[k];
+        x[i] = s / L[i][i];
+    }
+    return true;
+}
+}
+
+size_t ScanRegistration::alignScans(const ElevationMap& map, std::vector<CompletedScan>& scans) {
+    size_t applied = 0;
+    for (auto& sc : scans) applied += align(map, sc).applied ? 1 : 0;
+    return applied;
+}
+
+RegistrationResult ScanRegistration::align(const ElevationMap& map, CompletedScan& scan) {
+    RegistrationResult out;
+    tried.fetch_add(1, std::memory_order_relaxed);
+    const size_t n = scan.points.size();
+    if (n == 0 || n < policy.minMatches) return out;
+
+    const size_t stride = (n + policy.maxSamples - 1) / policy.maxSamples;
+    const size_t m = (n + stride - 1) / stride;
+    for (auto* v : {&sx, &sy, &sz, &qx, &qz, &res, &gx, &gz, &ax, &az, &mask, &mapY}) v->resize(m);
+    mapNormals.resize(3 * m);
+    mapN.resize(m);
+    mapOk.resize(m);
+    double cx = 0.0, cz = 0.0;
+    for (size_t k = 0; k < m; ++k) {
+        const LidarPoint& p = scan.points[k * stride];
+        sx[k] = p.x; sy[k] = p.y; sz[k] = p.z;
+        cx += p.x; cz += p.z;
+    }
+    // Rotate about the rover when its pose is known, else about the sample centroid
+    const float px = scan.hasPose ? scan.pose.posX : static_cast<float>(cx / static_cast<double>(m));
+    const float pz = scan.hasPose ? scan.pose.posZ : static_cast<float>(cz / static_cast<double>(m));
+    double lever2 = 0.0;
+    for (size_t k = 0; k < m; ++k) lever2 += (sx[k] - px) * (sx[k] - px) + (sz[k] - pz) * (sz[k] - pz);
+    lever2 = std::max(lever2 / static_cast<double>(m), 1.0);
+
+    const ResidualSoA soa{res.data(), gx.data(), gz.data(), ax.data(), az.data(), mask.data()};
+    double t[4] = {0.0, 0.0, 0.0, 0.0}; // dx, dy, dz, yaw (radians)
+    float acc[kAccumulators];
+    bool converged = false;
+    for (int it = 0;; ++it) {
+        const float c = static_cast<float>(std::cos(t[3])), s = static_cast<float>(std::sin(t[3]));
+        for (size_t k = 0; k < m; ++k) {
+            const float ox = sx[k] - px, oz = sz[k] - pz;
+            ax[k] = c * ox + s * oz;
+            az[k] = -s * ox + c * oz;
+            qx[k] = px + ax[k] + static_cast<float>(t[0]);
+            qz[k] = pz + az[k] + static_cast<float>(t[2]);
+        }
+        map.getGroundAtBatch(qx.data(), qz.data(), m, mapY.data(), mapN.data(), mapOk.data(), mapNormals.data());
+        for (size_t k = 0; k < m; ++k) {
+            const float nx = mapNormals[3 * k], ny = mapNormals[3 * k + 1], nz = mapNormals[3 * k + 2];
+            // Near-vertical faces have no usable height gradient
+            const bool ok = mapOk[k] && ny > 0.2f;
+            mask[k] = ok ? 1.0f : 0.0f;
+            res[k] = ok ? sy[k] + static_cast<float>(t[1]) - mapY[k] : 0.0f;
+            gx[k] = ok ? -nx / ny : 0.0f;
+            gz[k] = ok ? -nz / ny : 0.0f;
+        }
+        accumulate(soa, m, policy.huberDelta, policy.maxResidual, acc);
+        const size_t matches = static_cast<size_t>(acc[15]);
+        if (matches < policy.minMatches || acc[4] <= 0.0f) return out;
+        const float rms = std::sqrt(acc[14] / acc[4]);
+        if (it == 0) out.rmsBefore = rms;
+        out.rmsAfter = rms;
+        out.matches = matches;
+        out.iterations = it;
+        if (converged || it >= policy.maxIterations) break;
+
+        // Damped normal equations; the prior holds x, z and yaw at zero unless slopes say otherwise
+        const double prior = policy.horizontalPrior * static_cast<double>(matches);
+        const double P[4] = {prior, 0.0, prior, prior * lever2};
+        double H[4][4] = {{acc[0], acc[1], acc[2], acc[3]},
+                          {acc[1], acc[4], acc[5], acc[6]},
+                          {acc[2], acc[5], acc[7], acc[8]},
+                          {acc[3], acc[6], acc[8], acc[9]}};
+        double g[4] = {acc[10], acc[11], acc[12], acc[13]};
+        for (int k = 0; k < 4; ++k) {
+            H[k][k] += P[k] + 1e-6 * static_cast<double>(matches);
+            g[k] = -(g[k] + P[k] * t[k]);
+        }
+        double step[4];
+        if (!solve4(H, g, step)) return out;
+        for (int k = 0; k < 4; ++k) t[k] += step[k];
+        converged = std::fabs(step[0]) + std::fabs(step[1]) + std::fabs(step[2]) < 1e-3 &&
+                    std::fabs(step[3]) < 1e-4;
+    }
+
+    out.dx = static_cast<float>(t[0]);
+    out.dy = static_cast<float>(t[1]);
+    out.dz = static_cast<float>(t[2]);
+    out.dyawDeg = static_cast<float>(t[3] * kRadToDeg);
+    const bool withinLimits = std::hypot(out.dx, out.dz) <= policy.maxTranslation &&
+                              std::fabs(out.dy) <= policy.maxTranslation &&
+                              std::fabs(out.dyawDeg) <= policy.maxYawDeg;
+    if (!withinLimits || out.rmsAfter > out.rmsBefore) return out;
+
+    const float c = static_cast<float>(std::cos(t[3])), s = static_cast<float>(std::sin(t[3]));
+    for (LidarPoint& p : scan.points) {
+        const float ox = p.x - px, oz = p.z - pz;
+        p.x = px + c * ox + s * oz + out.dx;
+        p.y += out.dy;
+        p.z = pz - s * ox + c * oz + out.dz;
+    }
+    if (scan.hasPose) {
+        // The pivot is the rover, so its position only translates; Ry(yaw) composes onto the
+        // Ry * Rx * Rz pose rotation as a plain yaw offset
+        scan.pose.posX += out.dx;
+        scan.pose.posY += out.dy;
+        scan.pose.posZ += out.dz;
+        float yaw = scan.pose.rotYdeg + out.dyawDeg;
+        if (yaw > 180.0f) yaw -= 360.0f;
+        if (yaw < -180.0f) yaw += 360.0f;
+        scan.pose.rotYdeg = yaw;
+    }
+    out.applied = true;
+    corrected.fetch_add(1, std::memory_order_relaxed);
+    return out;
+}
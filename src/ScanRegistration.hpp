@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "DataAssembler.hpp"
+#include "QuadtreeMap.hpp"
+
+// Scan-to-map registration: estimates the rigid correction (translation plus yaw about the
+// rover) that best lays a scan onto the current ElevationMap heights, minimizing the
+// vertical point-to-heightfield distance with damped Gauss-Newton on a strided subsample.
+// Terrain slopes make the horizontal terms observable; on flat ground a small prior keeps
+// them at zero. Residual and normal-equation accumulation run in an AVX2 kernel when the
+// CPU has it, otherwise in a scalar loop with identical results up to rounding.
+struct RegistrationPolicy {
+    int maxIterations = 6;
+    size_t maxSamples = 4096;      // strided subsample of the scan
+    size_t minMatches = 200;       // confident map cells under the samples needed to try
+    float huberDelta = 0.5f;       // residuals past this are down-weighted (meters)
+    float maxResidual = 3.0f;      // and past this ignored (changed terrain, stray points)
+    float horizontalPrior = 0.03f; // prior weight of the x/z/yaw terms per matched sample
+    float maxTranslation = 2.0f;   // larger corrections are treated as divergence (meters)
+    float maxYawDeg = 5.0f;
+};
+
+struct RegistrationResult {
+    bool applied = false;
+    int iterations = 0;
+    size_t matches = 0;
+    float dx = 0.0f, dy = 0.0f, dz = 0.0f, dyawDeg = 0.0f;
+    float rmsBefore = 0.0f, rmsAfter = 0.0f;
+};
+
+class ScanRegistration {
+public:
+    void setPolicy(const RegistrationPolicy& p) { policy = p; }
+    const RegistrationPolicy& getPolicy() const { return policy; }
+
+    // Aligns scan.points to the map. When the fit converges inside the policy limits and does
+    // not raise the residual, the correction is applied to every point and to scan.pose.
+    RegistrationResult align(const ElevationMap& map, CompletedScan& scan);
+    size_t alignScans(const ElevationMap& map, std::vector<CompletedScan>& scans);
+
+    // Running totals; safe to read from any thread
+    uint64_t scansTried() const { return tried.load(std::memory_order_relaxed); }
+    uint64_t scansCorrected() const { return corrected.load(std::memory_order_relaxed); }
+
+private:
+    RegistrationPolicy policy;
+    std::atomic<uint64_t> tried{0};
+    std::atomic<uint64_t> corrected{0};
+
+    // Per-scan scratch in structure-of-arrays form, reused across scans
+    std::vector<float> sx, sy, sz;    // samples
+    std::vector<float> qx, qz;        // samples moved by the current estimate
+    std::vector<float> res, gx, gz, ax, az, mask;
+    std::vector<float> mapY, mapNormals;
+    std::vector<uint16_t> mapN;
+    std::vector<uint8_t> mapOk;
+};
@@ -0,0 +1,400 @@
+#include "TileStore.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+constexpr uint32_t kFileMagic = 0x5354414cu;   // "LATS"
+constexpr uint32_t kRecordMagic = 0x43455254u; // "TREC"
+constexpr uint32_t kVersion = 2; // 2: record headers carry the tile height bounds
+constexpr uint32_t kRecordDirty = 1u << 0;
+constexpr uint32_t kRecordPacked = 1u << 1;
+
+#pragma pack(push, 1)
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    float tileSize;
+    int32_t maxDepth;
+    uint8_t reserved[48];
+};
+
+struct RecordHeader {
+    uint32_t magic;
+    int32_t tx;
+    int32_t tz;
+    uint32_t flags;
+    uint32_t size;
+    uint32_t capacity;
+    uint32_t checksum; // FNV-1a of the stored payload; catches torn in-place rewrites
+    float minY;        // tile height bounds, so a restore can seed the pyramid unloaded
+    float maxY;
+    float mean;
+};
+#pragma pack(pop)
+
+bool pwriteAll(int fd, const void* data, size_t size, uint64_t offset) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t n = ::pwrite(fd, p, size, static_cast<off_t>(offset));
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+uint32_t fnv1a(const uint8_t* data, size_t size) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// PackBits-style run-length codec. Control byte c < 128: copy the next c+1 bytes;
+// c >= 128: repeat the next byte c-125 times (runs of 3..130).
+void packRuns(const std::vector<uint8_t>& in, std::vector<uint8_t>& out) {
+    out.clear();
+    out.reserve(in.size() / 2 + 16);
+    size_t i = 0;
+    const size_t n = in.size();
+    while (i < n) {
+        size_t run = 1;
+        while (i + run < n && run < 130 && in[i + run] == in[i]) run++;
+        if (run >= 3) {
+            out.push_back(static_cast<uint8_t>(run + 125));
+            out.push_back(in[i]);
+            i += run;
+            continue;
+        }
+        // Literal span up to the next run of 3 or 128 bytes
+        size_t start = i;
+        size_t len = 0;
+        while (i < n && len < 128) {
+            if (i + 2 < n && in[i] == in[i + 1] && in[i] == in[i + 2]) break;
+            i++;
+            len++;
+        }
+        out.push_back(static_cast<uint8_t>(len - 1));
+        out.insert(out.end(), in.begin() + static_cast<long>(start), in.begin() + static_cast<long>(start + len));
+    }
+}
+
+bool unpackRuns(const uint8_t* in, size_t size, std::vector<uint8_t>& out) {
+    out.clear();
+    size_t i = 0;
+    while (i < size) {
+        uint8_t c = in[i++];
+        if (c < 128) {
+            size_t len = static_cast<size_t>(c) + 1;
+            if (i + len > size) return false;
+            out.insert(out.end(), in + i, in + i + len);
+            i += len;
+        } else {
+            if (i >= size) return false;
+            out.insert(out.end(), static_cast<size_t>(c) - 125, in[i++]);
+        }
+    }
+    return true;
+}
+}
+
+TileStore::~TileStore() { close(); }
+
+bool TileStore::open(const std::string& path, float tileSizeMeters, int depth, bool restore) {
+    close();
+    std::lock_guard<std::mutex> lk(mutex);
+    int flags = O_RDWR | O_CREAT | (restore ? 0 : O_TRUNC);
+    int f = ::open(path.c_str(), flags, 0644);
+    if (f < 0) {
+        std::perror("open tile store");
+        return false;
+    }
+    fd = f;
+    tileSize = tileSizeMeters;
+    maxDepth = depth;
+    index.clear();
+    if (!restore || !indexExisting()) {
+        unmap();
+        index.clear();
+        if (!writeFreshHeader()) {
+            std::perror("write tile store header");
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+    }
+    stopping = false;
+    writer = std::thread(&TileStore::runWriter, this);
+    return true;
+}
+
+bool TileStore::writeFreshHeader() {
+    if (::ftruncate(fd, 0) != 0) return false;
+    FileHeader hdr{};
+    hdr.magic = kFileMagic;
+    hdr.version = kVersion;
+    hdr.tileSize = tileSize;
+    hdr.maxDepth = maxDepth;
+    if (!pwriteAll(fd, &hdr, sizeof(hdr), 0)) return false;
+    fileEnd = sizeof(FileHeader);
+    return true;
+}
+
+bool TileStore::indexExisting() {
+    struct stat sb{};
+    if (::fstat(fd, &sb) != 0 || static_cast<size_t>(sb.st_size) < sizeof(FileHeader)) return false;
+    uint64_t size = static_cast<uint64_t>(sb.st_size);
+    fileEnd = size;
+    if (!ensureMapped(size)) return false;
+    FileHeader hdr;
+    std::memcpy(&hdr, mapped, sizeof(hdr));
+    if (hdr.magic != kFileMagic || hdr.version != kVersion ||
+        hdr.tileSize != tileSize || hdr.maxDepth != maxDepth) {
+        std::fprintf(stderr, "Tile store geometry/version mismatch; starting a fresh map\n");
+        return false;
+    }
+    // Only record headers are touched here, so restoring is independent of tile contents.
+    // A relocated tile's live record always follows its abandoned ones: last one wins.
+    uint64_t off = sizeof(FileHeader);
+    while (off + sizeof(RecordHeader) <= size) {
+        RecordHeader rh;
+        std::memcpy(&rh, mapped + off, sizeof(rh));
+        uint64_t next = off + sizeof(RecordHeader) + rh.capacity;
+        if (rh.magic != kRecordMagic || rh.size > rh.capacity || next > size) break; // torn tail
+        Slot& slot = index[TileKey{rh.tx, rh.tz}];
+        slot.offset = off;
+        slot.size = rh.size;
+        slot.capacity = rh.capacity;
+        slot.flags = rh.flags;
+        slot.checksum = rh.checksum;
+        slot.bounds.minY = rh.minY;
+        slot.bounds.maxY = rh.maxY;
+        slot.bounds.mean = rh.mean;
+        off = next;
+    }
+    fileEnd = off;
+    return true;
+}
+
+void TileStore::close() {
+    flush();
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        stopping = true;
+    }
+    workCv.notify_all();
+    if (writer.joinable()) writer.join();
+    std::lock_guard<std::mutex> lk(mutex);
+    unmap();
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+    index.clear();
+    pending.clear();
+    fileEnd = 0;
+}
+
+bool TileStore::isOpen() const {
+    std::lock_guard<std::mutex> lk(mutex);
+    return fd >= 0;
+}
+
+void TileStore::setCompression(bool enable) {
+    std::lock_guard<std::mutex> lk(mutex);
+    compress = enable;
+}
+
+void TileStore::unmap() {
+    if (mapped) ::munmap(mapped, mappedBytes);
+    mapped = nullptr;
+    mappedBytes = 0;
+}
+
+bool TileStore::ensureMapped(uint64_t end) {
+    if (mapped && end <= mappedBytes) return true;
+    unmap();
+    size_t len = static_cast<size_t>(fileEnd);
+    if (len == 0) return false;
+    void* p = ::mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        std::perror("mmap tile store");
+        return false;
+    }
+    mapped = static_cast<uint8_t*>(p);
+    mappedBytes = len;
+    return end <= mappedBytes;
+}
+
+bool TileStore::contains(const TileKey& key) const {
+    std::lock_guard<std::mutex> lk(mutex);
+    return index.count(key) != 0;
+}
+
+std::vector<TileKey> TileStore::keys() const {
+    std::lock_guard<std::mutex> lk(mutex);
+    std::vector<TileKey> out;
+    out.reserve(index.size());
+    for (const auto& kv : index) out.push_back(kv.first);
+    return out;
+}
+
+std::vector<std::pair<TileKey, HeightBounds>> TileStore::storedBounds() const {
+    std::lock_guard<std::mutex> lk(mutex);
+    std::vector<std::pair<TileKey, HeightBounds>> out;
+    out.reserve(index.size());
+    for (const auto& kv : index) out.emplace_back(kv.first, kv.second.bounds);
+    return out;
+}
+
+size_t TileStore::tileCount() const {
+    std::lock_guard<std::mutex> lk(mutex);
+    return index.size();
+}
+
+size_t TileStore::fileBytes() const {
+    std::lock_guard<std::mutex> lk(mutex);
+    return static_cast<size_t>(fileEnd);
+}
+
+size_t TileStore::pendingCount() const {
+    std::lock_guard<std::mutex> lk(mutex);
+    return pending.size() + (hasInFlight ? 1 : 0);
+}
+
+void TileStore::save(const TileKey& key, const Tile& tile, bool uploadPending) {
+    PendingWrite w;
+    tile.serialize(w.blob);
+    w.flags = uploadPending ? kRecordDirty : 0u;
+    w.bounds = tile.bounds();
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        if (fd < 0) return;
+        index[key].bounds = w.bounds;
+        pending[key] = std::move(w);
+    }
+    workCv.notify_one();
+}
+
+void TileStore::flush() {
+    std::unique_lock<std::mutex> lk(mutex);
+    idleCv.wait(lk, [&] { return (pending.empty() && !hasInFlight) || !writer.joinable(); });
+}
+
+void TileStore::runWriter() {
+    std::vector<uint8_t> packed;
+    std::unique_lock<std::mutex> lk(mutex);
+    while (true) {
+        workCv.wait(lk, [&] { return stopping || !pending.empty(); });
+        if (pending.empty()) break; // stopping with nothing left to write
+        auto it = pending.begin();
+        inFlightKey = it->first;
+        inFlight = std::move(it->second);
+        hasInFlight = true;
+        pending.erase(it);
+        bool pack = compress;
+        lk.unlock();
+
+        // Encode outside the lock; load() may concurrently read inFlight.blob
+        const std::vector<uint8_t>* payload = &inFlight.blob;
+        uint32_t flags = inFlight.flags;
+        if (pack) {
+            packRuns(inFlight.blob, packed);
+            if (packed.size() < inFlight.blob.size()) {
+                payload = &packed;
+                flags |= kRecordPacked;
+            }
+        }
+        uint32_t checksum = fnv1a(payload->data(), payload->size());
+
+        lk.lock();
+        if (!writeLocked(inFlightKey, *payload, flags, checksum, inFlight.bounds)) std::perror("write tile record");
+        hasInFlight = false;
+        inFlight.blob.clear();
+        if (pending.empty()) idleCv.notify_all();
+    }
+}
+
+bool TileStore::writeLocked(const TileKey& key, const std::vector<uint8_t>& payload, uint32_t flags, uint32_t checksum,
+                            const HeightBounds& bounds) {
+    if (fd < 0) return false;
+    Slot& slot = index[key];
+    if (slot.offset == 0 || slot.capacity < payload.size()) {
+        // Leave ~25% headroom so a tile that keeps growing is not relocated on every write
+        uint32_t capacity = static_cast<uint32_t>(payload.size() + payload.size() / 4);
+        uint64_t newEnd = fileEnd + sizeof(RecordHeader) + capacity;
+        if (::ftruncate(fd, static_cast<off_t>(newEnd)) != 0) return false;
+        slot.offset = fileEnd;
+        slot.capacity = capacity;
+        fileEnd = newEnd;
+    }
+    slot.size = static_cast<uint32_t>(payload.size());
+    slot.flags = flags;
+    slot.checksum = checksum;
+    RecordHeader rh{};
+    rh.magic = kRecordMagic;
+    rh.tx = key.tx;
+    rh.tz = key.tz;
+    rh.flags = slot.flags;
+    rh.size = slot.size;
+    rh.capacity = slot.capacity;
+    rh.checksum = slot.checksum;
+    rh.minY = bounds.minY;
+    rh.maxY = bounds.maxY;
+    rh.mean = bounds.mean;
+    // Payload before header: an interrupted rewrite fails the checksum instead of decoding garbage
+    if (!pwriteAll(fd, payload.data(), payload.size(), slot.offset + sizeof(RecordHeader))) return false;
+    return pwriteAll(fd, &rh, sizeof(rh), slot.offset);
+}
+
+bool TileStore::load(const TileKey& key, Tile& out) {
+    // Only the copy of the record happens under the lock; decoding runs in parallel with the
+    // writer and with other readers (exports read spilled tiles from several threads)
+    thread_local std::vector<uint8_t> record, unpacked;
+    uint32_t flags = 0, checksum = 0;
+    bool fromQueue = false;
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        if (fd < 0) return false;
+        // Queued writes are newer than anything on disk
+        const PendingWrite* queued = nullptr;
+        auto pit = pending.find(key);
+        if (pit != pending.end()) queued = &pit->second;
+        else if (hasInFlight && !(inFlightKey < key) && !(key < inFlightKey)) queued = &inFlight;
+        if (queued) {
+            record.assign(queued->blob.begin(), queued->blob.end());
+            flags = queued->flags;
+            fromQueue = true;
+        } else {
+            auto it = index.find(key);
+            if (it == index.end() || it->second.offset == 0) return false;
+            const Slot& slot = it->second;
+            uint64_t begin = slot.offset + sizeof(RecordHeader);
+            if (!ensureMapped(begin + slot.size)) return false;
+            record.assign(mapped + begin, mapped + begin + slot.size);
+            flags = slot.flags;
+            checksum = slot.checksum;
+        }
+    }
+    out = Tile(key.tx * tileSize, key.tz * tileSize, tileSize, maxDepth);
+    const uint8_t* data = record.data();
+    size_t size = record.size();
+    if (!fromQueue) {
+        if (fnv1a(data, size) != checksum) return false;
+        if (flags & kRecordPacked) {
+            if (!unpackRuns(data, size, unpacked)) return false;
+            data = unpacked.data();
+            size = unpacked.size();
+        }
+    }
+    if (!out.deserialize(data, size)) return false;
+    out.dirty = (flags & kRecordDirty) != 0;
+    return true;
+}
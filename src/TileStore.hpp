@@ -0,0 +1,99 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "QuadtreeMap.hpp"
+
+// Memory-mapped backing file for tiles that are not resident in ElevationMap.
+// Layout: a fixed header followed by records (record header + serialized tile).
+// A rewritten tile reuses its slot when it fits, otherwise it is appended and the
+// old slot is abandoned. Reads deserialize straight out of the mapping.
+//
+// The same file doubles as the map checkpoint: writes are queued and performed by a
+// background thread, and reopening with restore=true indexes the record headers in
+// place so tiles fault in lazily instead of being rebuilt from live traffic.
+class TileStore {
+public:
+    TileStore() = default;
+    ~TileStore();
+    TileStore(const TileStore&) = delete;
+    TileStore& operator=(const TileStore&) = delete;
+
+    // Opens the backing file for the given tile geometry. Without restore (or when the
+    // existing file does not match the geometry) the file is truncated.
+    bool open(const std::string& path, float tileSize, int maxDepth, bool restore = false);
+    // Flushes queued writes and closes the file.
+    void close();
+    bool isOpen() const;
+
+    // Run-length pack records before writing (sparse tiles shrink considerably)
+    void setCompression(bool enable);
+
+    bool contains(const TileKey& key) const;
+    // Queues the tile for the writer thread; a newer save of the same key replaces a queued one.
+    // uploadPending comes back as Tile::dirty on load.
+    void save(const TileKey& key, const Tile& tile, bool uploadPending);
+    // Safe to call from several threads at once; the store lock is held only to copy the record.
+    bool load(const TileKey& key, Tile& out);
+    // Blocks until every queued tile has been written.
+    void flush();
+
+    std::vector<TileKey> keys() const;
+    // Every stored tile with its height bounds as of its last save; no tile is loaded
+    std::vector<std::pair<TileKey, HeightBounds>> storedBounds() const;
+    size_t tileCount() const;
+    size_t fileBytes() const;
+    size_t pendingCount() const;
+
+private:
+    struct Slot {
+        uint64_t offset = 0; // of the record header; 0 = queued, not yet on disk
+        uint32_t size = 0;
+        uint32_t capacity = 0;
+        uint32_t flags = 0;
+        uint32_t checksum = 0;
+        HeightBounds bounds;
+    };
+    struct PendingWrite {
+        std::vector<uint8_t> blob; // serialized tile, uncompressed
+        uint32_t flags = 0;
+        HeightBounds bounds;
+    };
+
+    bool indexExisting();
+    bool writeFreshHeader();
+    bool writeLocked(const TileKey& key, const std::vector<uint8_t>& payload, uint32_t flags, uint32_t checksum,
+                     const HeightBounds& bounds);
+    bool ensureMapped(uint64_t end);
+    void unmap();
+    void runWriter();
+
+    mutable std::mutex mutex;
+    std::condition_variable workCv;
+    std::condition_variable idleCv;
+    std::thread writer;
+    bool stopping = false;
+
+    int fd = -1;
+    float tileSize = 32.0f;
+    int maxDepth = 7;
+    uint64_t fileEnd = 0;
+    bool compress = false;
+
+    uint8_t* mapped = nullptr;
+    size_t mappedBytes = 0;
+
+    std::map<TileKey, Slot> index;
+    std::map<TileKey, PendingWrite> pending;
+    TileKey inFlightKey;
+    PendingWrite inFlight;
+    bool hasInFlight = false;
+};
@@ -0,0 +1,181 @@
+#include "Traversability.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "ScanBinning.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TRAV_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(TRAV_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TRAV_TARGET(isa) __attribute__((target(isa)))
+#else
+#define TRAV_TARGET(isa)
+#endif
+
+namespace {
+constexpr double kDegToRad = 3.14159265358979323846 / 180.0;
+
+struct Limits {
+    float inv8Cell;   // Sobel normalization
+    float cell;
+    float invSlope, invStep, invRoughness;
+};
+
+inline uint8_t quantizeCost(float cost, float centerValid) {
+    return centerValid != 0.0f ? static_cast<uint8_t>(static_cast<int32_t>(cost * 254.0f + 0.5f))
+                               : kTraversabilityUnknown;
+}
+
+// Cells [begin, cols) of output row j. Neighbour offsets are named by (dx, dz): m = -1, 0, p = +1.
+void rowScalar(const TraversabilityWindow& in, int j, int begin, int cols, const Limits& lim,
+               const TraversabilityRows& out) {
+    const float* h0 = in.height + static_cast<size_t>(j) * in.stride;
+    const float* h1 = h0 + in.stride;
+    const float* h2 = h1 + in.stride;
+    const float* v0 = in.valid + static_cast<size_t>(j) * in.stride;
+    const float* v1 = v0 + in.stride;
+    const float* v2 = v1 + in.stride;
+    const size_t o = static_cast<size_t>(j) * out.stride;
+    for (int i = begin; i < cols; ++i) {
+        const float c = h1[i + 1], vc = v1[i + 1];
+        const float vmm = v0[i], v0m = v0[i + 1], vpm = v0[i + 2];
+        const float vm0 = v1[i], vp0 = v1[i + 2];
+        const float vmp = v2[i], v0p = v2[i + 1], vpp = v2[i + 2];
+        const float dmm = vmm * (h0[i] - c), d0m = v0m * (h0[i + 1] - c), dpm = vpm * (h0[i + 2] - c);
+        const float dm0 = vm0 * (h1[i] - c), dp0 = vp0 * (h1[i + 2] - c);
+        const float dmp = vmp * (h2[i] - c), d0p = v0p * (h2[i + 1] - c), dpp = vpp * (h2[i + 2] - c);
+        const float gx = ((dpm + 2.0f * dp0 + dpp) - (dmm + 2.0f * dm0 + dmp)) * lim.inv8Cell;
+        const float gz = ((dmp + 2.0f * d0p + dpp) - (dmm + 2.0f * d0m + dpm)) * lim.inv8Cell;
+        float step = std::max(std::max(std::max(std::fabs(dmm), std::fabs(d0m)), std::max(std::fabs(dpm), std::fabs(dm0))),
+                              std::max(std::max(std::fabs(dp0), std::fabs(dmp)), std::max(std::fabs(d0p), std::fabs(dpp))));
+        // Residuals from the plane through the center with the Sobel gradient
+        const float gxc = gx * lim.cell, gzc = gz * lim.cell;
+        const float rmm = dmm + vmm * (gxc + gzc), r0m = d0m + v0m * gzc, rpm = dpm - vpm * (gxc - gzc);
+        const float rm0 = dm0 + vm0 * gxc, rp0 = dp0 - vp0 * gxc;
+        const float rmp = dmp + vmp * (gxc - gzc), r0p = d0p - v0p * gzc, rpp = dpp - vpp * (gxc + gzc);
+        const float sumR = ((rmm * rmm + r0m * r0m) + (rpm * rpm + rm0 * rm0)) +
+                           ((rp0 * rp0 + rmp * rmp) + (r0p * r0p + rpp * rpp));
+        const float sumV = ((vmm + v0m) + (vpm + vm0)) + ((vp0 + vmp) + (v0p + vpp));
+        float rough = std::sqrt(sumR / std::max(sumV, 1.0f));
+        float slope = std::sqrt(gx * gx + gz * gz);
+        slope *= vc; step *= vc; rough *= vc;
+        float cost = std::max(std::max(slope * lim.invSlope, step * lim.invStep), rough * lim.invRoughness);
+        cost = std::min(cost, 1.0f);
+        out.slope[o + i] = slope;
+        out.step[o + i] = step;
+        out.roughness[o + i] = rough;
+        out.cost[o + i] = quantizeCost(cost, vc);
+    }
+}
+
+#ifdef TRAV_X86
+TRAV_TARGET("avx2")
+inline __m256 absPs(__m256 v) {
+    return _mm256_and_ps(v, _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF)));
+}
+
+TRAV_TARGET("avx2")
+inline __m256 sqPs(__m256 v) {
+    return _mm256_mul_ps(v, v);
+}
+
+TRAV_TARGET("avx2")
+void rowsAvx2(const TraversabilityWindow& in, int rows, int cols, const Limits& lim, const TraversabilityRows& out) {
+    const __m256 two = _mm256_set1_ps(2.0f), one = _mm256_set1_ps(1.0f);
+    const __m256 inv8 = _mm256_set1_ps(lim.inv8Cell), cell = _mm256_set1_ps(lim.cell);
+    const __m256 invSlope = _mm256_set1_ps(lim.invSlope), invStep = _mm256_set1_ps(lim.invStep);
+    const __m256 invRough = _mm256_set1_ps(lim.invRoughness);
+    const __m256 q = _mm256_set1_ps(254.0f), half = _mm256_set1_ps(0.5f);
+    for (int j = 0; j < rows; ++j) {
+        const float* h0 = in.height + static_cast<size_t>(j) * in.stride;
+        const float* h1 = h0 + in.stride;
+        const float* h2 = h1 + in.stride;
+        const float* v0 = in.valid + static_cast<size_t>(j) * in.stride;
+        const float* v1 = v0 + in.stride;
+        const float* v2 = v1 + in.stride;
+        const size_t o = static_cast<size_t>(j) * out.stride;
+        int i = 0;
+        for (; i + 8 <= cols; i += 8) {
+            const __m256 c = _mm256_loadu_ps(h1 + i + 1), vc = _mm256_loadu_ps(v1 + i + 1);
+            const __m256 vmm = _mm256_loadu_ps(v0 + i), v0m = _mm256_loadu_ps(v0 + i + 1), vpm = _mm256_loadu_ps(v0 + i + 2);
+            const __m256 vm0 = _mm256_loadu_ps(v1 + i), vp0 = _mm256_loadu_ps(v1 + i + 2);
+            const __m256 vmp = _mm256_loadu_ps(v2 + i), v0p = _mm256_loadu_ps(v2 + i + 1), vpp = _mm256_loadu_ps(v2 + i + 2);
+            const __m256 dmm = _mm256_mul_ps(vmm, _mm256_sub_ps(_mm256_loadu_ps(h0 + i), c));
+            const __m256 d0m = _mm256_mul_ps(v0m, _mm256_sub_ps(_mm256_loadu_ps(h0 + i + 1), c));
+            const __m256 dpm = _mm256_mul_ps(vpm, _mm256_sub_ps(_mm256_loadu_ps(h0 + i + 2), c));
+            const __m256 dm0 = _mm256_mul_ps(vm0, _mm256_sub_ps(_mm256_loadu_ps(h1 + i), c));
+            const __m256 dp0 = _mm256_mul_ps(vp0, _mm256_sub_ps(_mm256_loadu_ps(h1 + i + 2), c));
+            const __m256 dmp = _mm256_mul_ps(vmp, _mm256_sub_ps(_mm256_loadu_ps(h2 + i), c));
+            const __m256 d0p = _mm256_mul_ps(v0p, _mm256_sub_ps(_mm256_loadu_ps(h2 + i + 1), c));
+            const __m256 dpp = _mm256_mul_ps(vpp, _mm256_sub_ps(_mm256_loadu_ps(h2 + i + 2), c));
+            const __m256 gx = _mm256_mul_ps(
+                _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(dpm, _mm256_mul_ps(two, dp0)), dpp),
+                              _mm256_add_ps(_mm256_add_ps(dmm, _mm256_mul_ps(two, dm0)), dmp)),
+                inv8);
+            const __m256 gz = _mm256_mul_ps(
+                _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(dmp, _mm256_mul_ps(two, d0p)), dpp),
+                              _mm256_add_ps(_mm256_add_ps(dmm, _mm256_mul_ps(two, d0m)), dpm)),
+                inv8);
+            __m256 step = _mm256_max_ps(
+                _mm256_max_ps(_mm256_max_ps(absPs(dmm), absPs(d0m)), _mm256_max_ps(absPs(dpm), absPs(dm0))),
+                _mm256_max_ps(_mm256_max_ps(absPs(dp0), absPs(dmp)), _mm256_max_ps(absPs(d0p), absPs(dpp))));
+            const __m256 gxc = _mm256_mul_ps(gx, cell), gzc = _mm256_mul_ps(gz, cell);
+            const __m256 sxz = _mm256_add_ps(gxc, gzc), dxz = _mm256_sub_ps(gxc, gzc);
+            const __m256 rmm = _mm256_add_ps(dmm, _mm256_mul_ps(vmm, sxz));
+            const __m256 r0m = _mm256_add_ps(d0m, _mm256_mul_ps(v0m, gzc));
+            const __m256 rpm = _mm256_sub_ps(dpm, _mm256_mul_ps(vpm, dxz));
+            const __m256 rm0 = _mm256_add_ps(dm0, _mm256_mul_ps(vm0, gxc));
+            const __m256 rp0 = _mm256_sub_ps(dp0, _mm256_mul_ps(vp0, gxc));
+            const __m256 rmp = _mm256_add_ps(dmp, _mm256_mul_ps(vmp, dxz));
+            const __m256 r0p = _mm256_sub_ps(d0p, _mm256_mul_ps(v0p, gzc));
+            const __m256 rpp = _mm256_sub_ps(dpp, _mm256_mul_ps(vpp, sxz));
+            const __m256 sumR = _mm256_add_ps(
+                _mm256_add_ps(_mm256_add_ps(sqPs(rmm), sqPs(r0m)), _mm256_add_ps(sqPs(rpm), sqPs(rm0))),
+                _mm256_add_ps(_mm256_add_ps(sqPs(rp0), sqPs(rmp)), _mm256_add_ps(sqPs(r0p), sqPs(rpp))));
+            const __m256 sumV = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(vmm, v0m), _mm256_add_ps(vpm, vm0)),
+                                              _mm256_add_ps(_mm256_add_ps(vp0, vmp), _mm256_add_ps(v0p, vpp)));
+            __m256 rough = _mm256_sqrt_ps(_mm256_div_ps(sumR, _mm256_max_ps(sumV, one)));
+            __m256 slope = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(gx, gx), _mm256_mul_ps(gz, gz)));
+            slope = _mm256_mul_ps(slope, vc);
+            step = _mm256_mul_ps(step, vc);
+            rough = _mm256_mul_ps(rough, vc);
+            __m256 cost = _mm256_max_ps(_mm256_max_ps(_mm256_mul_ps(slope, invSlope), _mm256_mul_ps(step, invStep)),
+                                        _mm256_mul_ps(rough, invRough));
+            cost = _mm256_min_ps(cost, one);
+            _mm256_storeu_ps(out.slope + o + i, slope);
+            _mm256_storeu_ps(out.step + o + i, step);
+            _mm256_storeu_ps(out.roughness + o + i, rough);
+            alignas(32) int32_t qi[8];
+            alignas(32) float vcs[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(qi), _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(cost, q), half)));
+            _mm256_store_ps(vcs, vc);
+            for (int k = 0; k < 8; ++k)
+                out.cost[o + i + k] = vcs[k] != 0.0f ? static_cast<uint8_t>(qi[k]) : kTraversabilityUnknown;
+        }
+        rowScalar(in, j, i, cols, lim, out);
+    }
+}
+#endif
+}
+
+void computeTraversability(const TraversabilityWindow& in, int cols, int rows, float cellSize,
+                           const TraversabilityPolicy& policy, const TraversabilityRows& out) {
+    if (cols <= 0 || rows <= 0) return;
+    Limits lim;
+    lim.cell = cellSize;
+    lim.inv8Cell = 1.0f / (8.0f * cellSize);
+    lim.invSlope = 1.0f / static_cast<float>(std::tan(std::clamp(policy.maxSlopeDeg, 1.0f, 89.0f) * kDegToRad));
+    lim.invStep = 1.0f / std::max(policy.maxStep, 1e-3f);
+    lim.invRoughness = 1.0f / std::max(policy.maxRoughness, 1e-3f);
+#ifdef TRAV_X86
+    if (cpuSupportsAvx2()) {
+        rowsAvx2(in, rows, cols, lim, out);
+        return;
+    }
+#endif
+    for (int j = 0; j < rows; ++j) rowScalar(in, j, 0, cols, lim, out);
+}
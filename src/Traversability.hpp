@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Limits at which each terrain measure alone makes a cell impassable (cost 1). The cost of a
+// cell is the largest of the three ratios, clamped to [0, 1].
+struct TraversabilityPolicy {
+    float maxSlopeDeg = 30.0f;
+    float maxStep = 0.5f;      // height jump to any of the 8 neighbours (meters)
+    float maxRoughness = 0.25f; // RMS residual of the 3x3 neighbourhood from its plane (meters)
+};
+
+// Terrain measures of one cell, from ElevationMap::getTraversabilityAt
+struct TraversabilityCell {
+    float slopeDeg = 0.0f;
+    float step = 0.0f;
+    float roughness = 0.0f;
+    float cost = 1.0f; // 0 = free, 1 = impassable
+};
+
+// Cost byte of a cell without a height; known cells store round(cost * 254)
+constexpr uint8_t kTraversabilityUnknown = 255;
+
+// Padded input: (cols + 2) x (rows + 2) heights and validity (1 or 0), row stride `stride`.
+// Missing neighbours count as level with the center cell.
+struct TraversabilityWindow {
+    const float* height = nullptr;
+    const float* valid = nullptr;
+    size_t stride = 0;
+};
+
+// Output rows; element (i, j) is at [j * stride + i]
+struct TraversabilityRows {
+    float* slope = nullptr;     // rise over run
+    float* step = nullptr;
+    float* roughness = nullptr;
+    uint8_t* cost = nullptr;
+    size_t stride = 0;
+};
+
+// Slope (Sobel gradient), step and roughness of cols x rows cells. Runs an AVX2 kernel when
+// the CPU has it, otherwise a scalar loop with identical results.
+void computeTraversability(const TraversabilityWindow& in, int cols, int rows, float cellSize,
+                           const TraversabilityPolicy& policy, const TraversabilityRows& out);
@@ -0,0 +1,92 @@
+#include "VoxelDownsampler.hpp"
+
+#include <algorithm>
+
+#include "ScanBinning.hpp"
+
+namespace {
+// 21 bits per axis; voxels 2^21 leaves apart (about 1000 km at 0.5 m) would share a key
+inline uint64_t packVoxelKey(int32_t vx, int32_t vy, int32_t vz) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(vx) & 0x1FFFFFu) << 42) |
+           (static_cast<uint64_t>(static_cast<uint32_t>(vy) & 0x1FFFFFu) << 21) |
+           (static_cast<uint64_t>(static_cast<uint32_t>(vz) & 0x1FFFFFu));
+}
+}
+
+void VoxelDownsampler::setRoverBudget(const std::string& roverId, float pointsPerSecond) {
+    budgets[roverId].pointsPerSecond = std::max(pointsPerSecond, 0.0f);
+}
+
+size_t VoxelDownsampler::downsampleScans(std::vector<CompletedScan>& scans) {
+    size_t removed = 0;
+    for (auto& sc : scans) removed += downsample(sc.roverId, sc.timestamp, sc.points);
+    return removed;
+}
+
+size_t VoxelDownsampler::downsample(const std::string& roverId, double timestamp, std::vector<LidarPoint>& points) {
+    const size_t n = points.size();
+    seenIn.fetch_add(n, std::memory_order_relaxed);
+    if (n == 0) return 0;
+
+    // At most one voxel per point; the table only grows, and stale slots are told apart by stamp
+    size_t capacity = std::max<size_t>(table.size(), 16);
+    while (capacity < 2 * n) capacity <<= 1;
+    if (capacity != table.size()) {
+        table.assign(capacity, Voxel{});
+        stamp = 0;
+    }
+    if (++stamp == 0) {
+        for (Voxel& v : table) v.stamp = 0;
+        stamp = 1;
+    }
+    const uint64_t mask = capacity - 1;
+    const float inv = 1.0f / std::max(policy.leafSize, 1e-3f);
+    occupied.clear();
+    for (const LidarPoint& p : points) {
+        const uint64_t key = packVoxelKey(floorToInt(p.x * inv), floorToInt(p.y * inv), floorToInt(p.z * inv));
+        uint64_t slot = hashCellKey(key) & mask;
+        while (table[slot].stamp == stamp && table[slot].key != key) slot = (slot + 1) & mask;
+        Voxel& v = table[slot];
+        if (v.stamp != stamp) {
+            v.key = key;
+            v.stamp = stamp;
+            v.count = 0;
+            v.sx = v.sy = v.sz = 0.0f;
+            occupied.push_back(static_cast<uint32_t>(slot));
+        }
+        v.count++;
+        v.sx += p.x;
+        v.sy += p.y;
+        v.sz += p.z;
+    }
+
+    const size_t voxels = occupied.size();
+    const size_t allowed = admit(budgets[roverId], timestamp, voxels);
+    // Centroids overwrite the front of the scan; over budget, take every (voxels/allowed)-th voxel
+    for (size_t k = 0; k < allowed; ++k) {
+        const size_t pick = allowed == voxels ? k : k * voxels / allowed;
+        const Voxel& v = table[occupied[pick]];
+        const float invCount = 1.0f / static_cast<float>(v.count);
+        points[k] = LidarPoint{ v.sx * invCount, v.sy * invCount, v.sz * invCount };
+    }
+    points.resize(allowed);
+    seenOut.fetch_add(allowed, std::memory_order_relaxed);
+    return n - allowed;
+}
+
+size_t VoxelDownsampler::admit(Budget& b, double timestamp, size_t wanted) {
+    const double rate = b.pointsPerSecond >= 0.0f ? b.pointsPerSecond : policy.pointsPerSecond;
+    if (rate <= 0.0) return wanted;
+    const double dt = timestamp - b.lastTs;
+    if (!b.started || dt < 0.0) {
+        // First scan, or the rover's clock restarted: begin with a full second of budget
+        b.tokens = rate;
+        b.started = true;
+    } else {
+        b.tokens = std::min(rate, b.tokens + dt * rate);
+    }
+    b.lastTs = timestamp;
+    const size_t allowed = std::min(wanted, static_cast<size_t>(std::max(b.tokens, 0.0)));
+    b.tokens -= static_cast<double>(allowed);
+    return allowed;
+}
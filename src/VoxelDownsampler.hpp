@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "DataAssembler.hpp"
+
+// Voxel-grid downsampling between DataAssembler and ElevationMap: every occupied voxel of
+// a scan is replaced by the centroid of its points. Hashing is a single pass over the scan
+// into a table that is reused across scans (no per-scan allocation once warmed up).
+//
+// Each rover also has a point budget in points per second of scan time (token bucket with
+// one second of burst). Scans over budget keep an evenly strided subset of their voxels,
+// so integration cost follows covered ground, not how fast a rover re-scans it.
+struct DownsamplePolicy {
+    float leafSize = 0.5f;       // voxel edge, meters
+    float pointsPerSecond = 0.0f; // default per-rover budget; 0 = unlimited
+};
+
+class VoxelDownsampler {
+public:
+    void setPolicy(const DownsamplePolicy& p) { policy = p; }
+    const DownsamplePolicy& getPolicy() const { return policy; }
+    // Overrides the default budget for one rover (0 = unlimited)
+    void setRoverBudget(const std::string& roverId, float pointsPerSecond);
+
+    // Downsamples in place; timestamp is the scan's own clock. Returns the number of points removed.
+    size_t downsample(const std::string& roverId, double timestamp, std::vector<LidarPoint>& points);
+    size_t downsampleScans(std::vector<CompletedScan>& scans);
+
+    // Running totals; safe to read from any thread
+    uint64_t pointsIn() const { return seenIn.load(std::memory_order_relaxed); }
+    uint64_t pointsOut() const { return seenOut.load(std::memory_order_relaxed); }
+
+private:
+    struct Voxel {
+        uint64_t key = 0;
+        uint32_t stamp = 0; // slot is live only when it matches the current scan
+        uint32_t count = 0;
+        float sx = 0.0f, sy = 0.0f, sz = 0.0f;
+    };
+    struct Budget {
+        float pointsPerSecond = -1.0f; // < 0: use the policy default
+        double tokens = 0.0;
+        double lastTs = 0.0;
+        bool started = false;
+    };
+
+    size_t admit(Budget& b, double timestamp, size_t wanted);
+
+    DownsamplePolicy policy;
+    std::map<std::string, Budget> budgets;
+
+    std::vector<Voxel> table;
+    std::vector<uint32_t> occupied; // slots in first-touch order
+    uint32_t stamp = 0;
+
+    std::atomic<uint64_t> seenIn{0};
+    std::atomic<uint64_t> seenOut{0};
+};
@@ -9,10 +9,17 @@
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_opengl3.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdio>
 #include <map>
 #include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 
 #include <glm/gtc/matrix_transform.hpp>
@@ -22,9 +29,17 @@
 #include "DataAssembler.hpp"
 #include "Renderer.hpp"
 #include "QuadtreeMap.hpp"
+#include "MemoryMonitor.hpp"
+#include "MapExport.hpp"
+#include "MotionGate.hpp"
+#include "PoseEstimator.hpp"
+#include "PoseHistory.hpp"
+#include "ScanFilter.hpp"
+#include "ScanIntegrator.hpp"
+#include "ScanRegistration.hpp"
+#include "VoxelDownsampler.hpp"
 
 struct RoverState {
-    PosePacket lastPose{};
     VehicleTelem lastTelem{};
     uint8_t localCmdBits = 0;
 };
@@ -79,9 +94,45 @@ int main() {
     ElevationMap elevMap;
     // Do not store raw points; elevation map is our primary product
     assembler.setStoreGlobalPoints(false);
+    // Scans that only repeat what a parked rover already reported are skipped (1 in 10 still kept)
+    MotionGate motionGate;
+    // Remaining scans pass a statistical outlier filter, so acceptance and replacement can be
+    // tighter than the constructor defaults (0.7 m / 1.6 m) tuned for unfiltered input
+    OutlierFilter outlierFilter;
+    elevMap.setParameters(32.0f, 0.25f, 0.6f, 1.2f, 8, 60, 12, 0.15f, 2.0f);
+    // Each scan is then registered against the map heights, correcting its offset and pose
+    ScanRegistration registration;
+    // Then one centroid per map-cell-sized voxel, at most 150k points/s of scan time per rover
+    VoxelDownsampler downsampler;
+    downsampler.setPolicy(DownsamplePolicy{0.25f, 150000.0f});
+    // Split cells only where the ground is rough; flat terrain stays in coarse leaves
+    elevMap.setAdaptiveRefinement(true);
+    // Each rover integrates into its own contribution layer (in parallel across rovers) and the
+    // layers are fused by confidence, so offsets between rovers do not flip cells back and forth
+    elevMap.setRoverLayers(true);
+    for (const auto& [id, _] : profiles) elevMap.addRoverLayer(id);
+    // One pool thread per rover layer (the mapping thread is one of them), kept for the whole run
+    ScanIntegrator integrator(static_cast<unsigned>(profiles.size()));
+    // Confidence halves every 10 minutes a cell goes unobserved, so terrain that changed while
+    // no rover was looking is taken over after a few scans instead of fought for K in a row
+    elevMap.setAging(600.0f);
+    // Spill far-away tiles to disk so long missions stay bounded (~0.45 GB of fully split tiles).
+    // The same file is the map checkpoint: a restart picks up the previous map from it.
+    const size_t maxResidentTiles = 1024;
+    if (!elevMap.enableTileStore("elevation.tiles", maxResidentTiles, /*restoreExisting=*/true)) {
+        std::fprintf(stderr, "Tile store unavailable; elevation map will stay fully resident\n");
+    }
 
+    // Pose history per rover, so scans get the pose at their own timestamp. The map is filled
+    // here and never changes shape; each history has one writer (that rover's pose thread).
+    std::map<std::string, PoseHistory> poseHistory;
+    // Smoothed rover poses are filtered on the pose threads and published lock-free; the
+    // renderer only reads them.
+    PoseEstimator poseEstimator;
     std::map<std::string, int> posePorts, lidarPorts, telemPorts, cmdPorts;
     for (const auto& [id, p] : profiles) {
+        poseHistory[id];
+        poseEstimator.addRover(id);
         posePorts[id] = p.posePort;
         lidarPorts[id] = p.lidarPort;
         telemPorts[id] = p.telemPort;
@@ -89,9 +140,15 @@ int main() {
     }
 
     net.setPoseCallback([&](const std::string& id, const PosePacket& pose){
-        roverState[id].lastPose = pose;
-        renderer.updateRoverState(id, pose);
+        poseEstimator.update(id, pose);
+        poseHistory.at(id).push(pose);
     });
+    // Latest pose of a rover, readable from any thread; zeros before its first pose.
+    auto roverPose = [&poseEstimator](const std::string& id) {
+        PoseEstimate est;
+        poseEstimator.latest(poseEstimator.indexOf(id), est);
+        return est;
+    };
     net.setLidarCallback([&](const std::string& id, const LidarPacketHeader& hdr, const LidarPoint* pts, size_t count){
         assembler.addChunk(id, hdr, pts, count);
     });
@@ -101,9 +158,93 @@ int main() {
 
     net.start(posePorts, lidarPorts, telemPorts);
 
+    // Mapping runs on its own thread and is the only user of elevMap. The render loop reads the
+    // latest published snapshot and trades small batches with it through mapIo.
+    struct MappingIo {
+        std::mutex mutex;
+        std::vector<std::pair<float, float>> anchors; // in: rover and camera XZ to keep resident
+        std::vector<TileUpdate> updates;              // out: tiles to upload
+        std::vector<ChangeEvent> changes;             // out: terrain change events
+        std::vector<std::string> changeRovers;        // out: names by ChangeEvent::rover
+        std::vector<TileKey> reloads;                 // in: tiles the renderer dropped and needs again
+        size_t memoryBudget = 0;                      // in: resident map bytes (see setMemoryBudget)
+    } mapIo;
+    std::shared_ptr<const ElevationMap> mapView = elevMap.snapshot();
+    std::atomic<bool> mappingRunning{true};
+    std::thread mappingThread([&]{
+        auto lastCheckpoint = std::chrono::steady_clock::now();
+        auto lastPublish = lastCheckpoint;
+        bool unpublished = false;
+        std::vector<std::pair<float, float>> anchors;
+        std::vector<TileKey> reloads;
+        std::vector<std::string> changeRovers;
+        while (mappingRunning.load()) {
+            auto scans = assembler.retrieveCompleted();
+            for (auto& sc : scans) {
+                auto ph = poseHistory.find(sc.roverId);
+                sc.hasPose = ph != poseHistory.end() && ph->second.sampleAt(sc.timestamp, sc.pose);
+            }
+            motionGate.gateScans(scans);
+            outlierFilter.filterScans(scans);
+            registration.alignScans(elevMap, scans);
+            downsampler.downsampleScans(scans);
+            integrator.integrateScans(elevMap, scans);
+            // Slope/step/roughness around the cells that changed (bounded after a large restore)
+            elevMap.updateTraversability(size_t(1) << 18);
+            auto changes = elevMap.consumeChanges();
+            const size_t knownRovers = changeRovers.size();
+            for (const auto& ev : changes) {
+                while (changeRovers.size() <= ev.rover)
+                    changeRovers.push_back(elevMap.changeRoverName(static_cast<uint16_t>(changeRovers.size())));
+            }
+            bool uploadPending = false;
+            {
+                std::lock_guard<std::mutex> lock(mapIo.mutex);
+                anchors = mapIo.anchors;
+                reloads.swap(mapIo.reloads);
+                elevMap.setMemoryBudget(mapIo.memoryBudget);
+                uploadPending = !mapIo.updates.empty();
+            }
+            // Keep tiles around the rovers and the camera resident; spill the rest
+            elevMap.evictDistantTiles(anchors);
+            elevMap.requestTileUploads(reloads);
+            reloads.clear();
+            // Hand changed tiles to the background checkpoint writer every couple of seconds
+            auto now = std::chrono::steady_clock::now();
+            if (now - lastCheckpoint > std::chrono::seconds(2)) {
+                elevMap.checkpointDirtyTiles(256);
+                lastCheckpoint = now;
+            }
+            // Next upload batch (~10 MB) once the render loop has taken the previous one
+            std::vector<TileUpdate> updates;
+            if (!uploadPending) updates = elevMap.consumeDirtyTilesBudgeted(10 * 1024 * 1024);
+            // Publish at most ~30 Hz: after a snapshot, the first change to each tile copies it
+            unpublished = unpublished || !scans.empty() || !updates.empty();
+            if (unpublished && now - lastPublish > std::chrono::milliseconds(30)) {
+                std::atomic_store(&mapView, elevMap.snapshot());
+                lastPublish = now;
+                unpublished = false;
+            }
+            if (!updates.empty() || !changes.empty()) {
+                std::lock_guard<std::mutex> lock(mapIo.mutex);
+                for (auto& up : updates) mapIo.updates.push_back(std::move(up));
+                for (auto& ev : changes) mapIo.changes.push_back(std::move(ev));
+                if (changeRovers.size() != knownRovers) mapIo.changeRovers = changeRovers;
+            }
+            if (scans.empty()) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+
+    // Map view for the current frame; every map read in the render loop goes through it
+    std::shared_ptr<const ElevationMap> frameMap = std::atomic_load(&mapView);
+
     // Provide renderer a ground sampler backed by elevation map (z_mean). Use only when confident.
     renderer.setGroundSampler([&](float x, float z, float& outY, uint16_t& outN){
-        return elevMap.getGroundAt(x, z, &outY, &outN);
+        return frameMap->getGroundAt(x, z, &outY, &outN);
+    });
+    renderer.setGroundBatchSampler([&](const float* xs, const float* zs, size_t count,
+                                       float* outY, uint16_t* outN, uint8_t* outOk, float* outNormals){
+        frameMap->getGroundAtBatch(xs, zs, count, outY, outN, outOk, outNormals);
     });
 
     auto last = std::chrono::high_resolution_clock::now();
@@ -120,6 +261,7 @@ int main() {
         {1.0f, 0.3f, 0.3f}, {0.3f, 1.0f, 0.3f}, {0.3f, 0.6f, 1.0f}, {1.0f, 0.8f, 0.2f}, {0.8f, 0.3f, 1.0f}
     };
     int colorIdx = 0;
+    renderer.setPoseEstimator(&poseEstimator);
     for (const auto& [id, _] : profiles) {
         renderer.setRoverColor(id, palette[colorIdx % palette.size()]);
         // Default forward offset of +1.0 m to account for sensor-vs-body origin
@@ -146,6 +288,34 @@ int main() {
     bool centerKeyDownPrev = false; // for edge-triggered 'C' center action
     bool pendingCenter = false;     // apply centering after camera logic
     bool suppressFollowOnce = false; // skip one follow update after centering
+    bool avoidTerrainOcclusion = true; // pull the follow camera in front of terrain blocking the rover
+    glm::mat4 lastViewProj(1.0f);      // previous frame, for cursor picking
+    RayHit cursorHit;
+    bool cursorHitValid = false;
+    bool pendingFocus = false;         // center on the picked point instead of the rover
+    std::deque<ChangeEvent> recentChanges;
+    std::vector<std::string> changeRovers;
+    size_t changedCellsWindow = 0;
+    float changedCellsPerSec = 0.0f;
+    auto lastChangeRate = std::chrono::high_resolution_clock::now();
+    // Memory dashboard. Budgets in MB (0 = none, the default) are enforced by the owners: the
+    // assembler drops buffered points, the map spills tiles to the store, the renderer drops far
+    // tile buffers.
+    MemoryMonitor memory;
+    int budgetMb[kMemorySubsystems] = {0, 0, 0, 0};
+    auto applyBudgets = [&]{
+        auto bytes = [&](MemorySubsystem s) { return static_cast<size_t>(std::max(budgetMb[static_cast<size_t>(s)], 0)) << 20; };
+        for (size_t i = 0; i < kMemorySubsystems; ++i) memory.setBudget(static_cast<MemorySubsystem>(i), bytes(static_cast<MemorySubsystem>(i)));
+        assembler.setMemoryBudget(bytes(MemorySubsystem::Assembler));
+        renderer.setGpuMemoryBudget(bytes(MemorySubsystem::Gpu));
+        std::lock_guard<std::mutex> lock(mapIo.mutex);
+        mapIo.memoryBudget = bytes(MemorySubsystem::Map);
+    };
+    applyBudgets();
+    // Exports read the frame's map snapshot on their own threads, so mapping carries on
+    std::future<ExportResult> exportJob;
+    std::string exportStatus;
+    float exportRadius = 250.0f;
 
     std::string selectedRover = profiles.begin()->first;
 
@@ -170,15 +340,49 @@ int main() {
 
         // Data maintenance
         assembler.maintenance(0.0);
-        auto scans = assembler.retrieveCompleted();
-        // Integrate completed scans into elevation map
-        for (const auto& sc : scans) {
-            elevMap.integrateScan(sc.points, sc.timestamp);
+        std::vector<TileUpdate> updates;
+        std::vector<ChangeEvent> changes;
+        {
+            std::lock_guard<std::mutex> lock(mapIo.mutex);
+            // Keep tiles around the rovers and the camera resident
+            mapIo.anchors.clear();
+            for (const auto& [id, _] : profiles) {
+                PoseEstimate est;
+                if (poseEstimator.latest(poseEstimator.indexOf(id), est)) mapIo.anchors.emplace_back(est.posX, est.posZ);
+            }
+            mapIo.anchors.emplace_back(camPos.x, camPos.z);
+            updates.swap(mapIo.updates);
+            changes.swap(mapIo.changes);
+            if (mapIo.changeRovers.size() != changeRovers.size()) changeRovers = mapIo.changeRovers;
+            // Tiles the GPU budget dropped, once they are in view and fit again
+            renderer.takeTilesToReload(64, mapIo.reloads);
+        }
+        frameMap = std::atomic_load(&mapView);
+        // Terrain change stream: cell update rate plus the last few surface changes for the UI
+        for (auto& ev : changes) {
+            changedCellsWindow += ev.merged;
+            if ((ev.kind & (CHANGE_REPLACED | CHANGE_DRIFTED)) && ev.maxDelta >= 0.5f) {
+                recentChanges.push_back(std::move(ev));
+                if (recentChanges.size() > 8) recentChanges.pop_front();
+            }
         }
-        // Upload dirty tiles to GPU on a budget (~10 MB per frame)
-        renderer.ensureTerrainPipeline(elevMap.getGridNVertices());
-        auto updates = elevMap.consumeDirtyTilesBudgeted(10 * 1024 * 1024);
+        if (now - lastChangeRate > std::chrono::seconds(1)) {
+            changedCellsPerSec = static_cast<float>(changedCellsWindow) /
+                                 std::chrono::duration<float>(now - lastChangeRate).count();
+            changedCellsWindow = 0;
+            lastChangeRate = now;
+        }
+        // Upload the tiles the mapping thread prepared (budgeted there)
+        renderer.ensureTerrainPipeline(frameMap->getGridNVertices());
         renderer.uploadDirtyTiles(updates);
+        {
+            const double t = std::chrono::duration<double>(now.time_since_epoch()).count();
+            const ElevationStats st = frameMap->getStats();
+            memory.record(MemorySubsystem::Network, net.getMemoryUsage(), t);
+            memory.record(MemorySubsystem::Assembler, assembler.getMemoryUsage(), t);
+            memory.record(MemorySubsystem::Map, MemoryUsage{st.residentBytes(), st.allocatedBytes}, t);
+            memory.record(MemorySubsystem::Gpu, renderer.getGpuMemoryUsage(), t);
+        }
 
         // UI frame
         ImGui_ImplOpenGL3_NewFrame();
@@ -219,8 +423,30 @@ int main() {
 
         if (ImGui::CollapsingHeader("Telemetry & Commands", ImGuiTreeNodeFlags_DefaultOpen)) {
         const RoverState& rs = roverState[selectedRover];
-        ImGui::Text("Pos: %.2f %.2f %.2f", rs.lastPose.posX, rs.lastPose.posY, rs.lastPose.posZ);
-        ImGui::Text("Rot: %.1f %.1f %.1f", rs.lastPose.rotXdeg, rs.lastPose.rotYdeg, rs.lastPose.rotZdeg);
+        const PoseEstimate pose = roverPose(selectedRover);
+        ImGui::Text("Pos: %.2f %.2f %.2f", pose.posX, pose.posY, pose.posZ);
+        ImGui::Text("Rot: %.1f %.1f %.1f", pose.rotXdeg, pose.rotYdeg, pose.rotZdeg);
+        {
+            // Line of sight from the selected rover to the others, at roughly sensor height
+            const float sensorH = 1.5f;
+            std::string visible;
+            for (const auto& [id, _] : profiles) {
+                if (id == selectedRover) continue;
+                const PoseEstimate other = roverPose(id);
+                if (frameMap->lineOfSight(pose.posX, pose.posY + sensorH, pose.posZ,
+                                        other.posX, other.posY + sensorH, other.posZ)) {
+                    visible += id + " ";
+                }
+            }
+            ImGui::Text("Line of sight: %s", visible.empty() ? "-" : visible.c_str());
+            TraversabilityCell trav;
+            if (frameMap->getTraversabilityAt(pose.posX, pose.posZ, &trav)) {
+                ImGui::Text("Terrain: slope %.1f deg, step %.2f m, rough %.2f m, cost %.2f",
+                            trav.slopeDeg, trav.step, trav.roughness, trav.cost);
+            } else {
+                ImGui::Text("Terrain: -");
+            }
+        }
 
         uint8_t before = roverState[selectedRover].localCmdBits;
         for (int b = 0; b < 4; ++b) {
@@ -251,6 +477,21 @@ int main() {
         ImGui::Text("Last Telem ts: %.3f", ts.lastTelemTs);
         ImGui::Text("FPS (avg %.1fs): %.1f", fpsWindowSeconds, fps);
         ImGui::Text("Points: %zu", assembler.getGlobalTerrain().size());
+        ImGui::Text("Binning kernel: %s", binningKernelName());
+        {
+            uint64_t seen = outlierFilter.pointsSeen();
+            double pct = seen ? 100.0 * static_cast<double>(outlierFilter.pointsRejected()) / static_cast<double>(seen) : 0.0;
+            ImGui::Text("Outliers rejected: %.2f%%", pct);
+            uint64_t in = downsampler.pointsIn();
+            double kept = in ? 100.0 * static_cast<double>(downsampler.pointsOut()) / static_cast<double>(in) : 100.0;
+            ImGui::Text("Downsampled to: %.1f%%", kept);
+            uint64_t scansIn = motionGate.scansSeen();
+            double skippedPct = scansIn ? 100.0 * static_cast<double>(motionGate.scansSkipped()) / static_cast<double>(scansIn) : 0.0;
+            ImGui::Text("Redundant scans skipped: %.1f%%", skippedPct);
+            uint64_t regTried = registration.scansTried();
+            double regPct = regTried ? 100.0 * static_cast<double>(registration.scansCorrected()) / static_cast<double>(regTried) : 0.0;
+            ImGui::Text("Scans registered to map: %.1f%%", regPct);
+        }
         {
             float tdd = renderer.getTerrainDrawDistance();
             if (ImGui::SliderFloat("Terrain draw distance", &tdd, 200.0f, 3000.0f)) {
@@ -276,6 +517,90 @@ int main() {
             ImGui::Separator();
         }
 
+        if (ImGui::CollapsingHeader("Terrain changes")) {
+            ImGui::Text("Cell updates: %.0f /s", changedCellsPerSec);
+            for (auto it = recentChanges.rbegin(); it != recentChanges.rend(); ++it) {
+                const ChangeEvent& ev = *it;
+                const char* rover = ev.rover < changeRovers.size() ? changeRovers[ev.rover].c_str() : "?";
+                ImGui::Text("%s tile %d,%d (%dx%d) %s %.2f -> %.2f m (rover %s, t=%.1f)",
+                            ev.region ? "region" : "cell", ev.tile.tx, ev.tile.tz, ev.tileSpan, ev.tileSpan,
+                            (ev.kind & CHANGE_REPLACED) ? "replaced" : "drifted",
+                            ev.oldY, ev.newY, rover, ev.timestamp);
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Map")) {
+            const ElevationStats st = frameMap->getStats();
+            const float mb = 1.0f / (1024.0f * 1024.0f);
+            ImGui::Text("Tiles: %zu resident, %zu spilled, %zu awaiting upload",
+                        st.numTiles, st.numSpilledTiles, st.numDirtyTiles);
+            ImGui::Text("Leaves: %zu (%zu observed)", st.numLeaves, st.numValidCells);
+            ImGui::Text("Tree %.1f MB, layers %.1f MB, traversability %.1f MB",
+                        st.treeBytes * mb, st.layerBytes * mb, st.traversabilityBytes * mb);
+            ImGui::Text("Rover layers %.1f MB, change events %.1f MB, store file %.1f MB",
+                        st.roverLayerBytes * mb, st.changeBytes * mb, st.storeBytes * mb);
+        }
+
+        if (ImGui::CollapsingHeader("Memory")) {
+            const float mb = 1.0f / (1024.0f * 1024.0f);
+            ImGui::Text("Total %.1f MB", memory.totalLiveBytes() * mb);
+            bool budgetsChanged = false;
+            for (size_t i = 0; i < kMemorySubsystems; ++i) {
+                const auto sub = static_cast<MemorySubsystem>(i);
+                ImGui::PushID(static_cast<int>(i));
+                ImGui::Text("%-9s %8.1f MB (peak %.1f)  %.2f MB/s allocated", MemoryMonitor::name(sub),
+                            memory.usage(sub).liveBytes * mb, memory.peakBytes(sub) * mb,
+                            memory.allocationRate(sub) * mb);
+                // Network buffers are fixed per socket; there is nothing to evict
+                if (sub != MemorySubsystem::Network) {
+                    ImGui::SetNextItemWidth(120.0f);
+                    budgetsChanged |= ImGui::InputInt("Budget (MB, 0 = none)", &budgetMb[i], 64, 256);
+                    if (memory.budget(sub) > 0) {
+                        ImGui::SameLine();
+                        ImGui::ProgressBar(std::min(memory.budgetFraction(sub), 1.0f), ImVec2(-1.0f, 0.0f));
+                    }
+                }
+                ImGui::PopID();
+            }
+            if (budgetsChanged) applyBudgets();
+        }
+
+        if (ImGui::CollapsingHeader("Export")) {
+            const bool busy = exportJob.valid();
+            if (busy && exportJob.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                const ExportResult r = exportJob.get();
+                char line[256];
+                if (!r.ok) std::snprintf(line, sizeof(line), "Export failed: %s", r.error.c_str());
+                else if (r.faces > 0) std::snprintf(line, sizeof(line), "Mesh: %llu vertices, %llu faces, %.1f MB in %.2f s",
+                                                    static_cast<unsigned long long>(r.vertices), static_cast<unsigned long long>(r.faces),
+                                                    r.bytes / (1024.0 * 1024.0), r.seconds);
+                else std::snprintf(line, sizeof(line), "Raster: %zu tiles, %.1f MB in %.2f s", r.tiles,
+                                   r.bytes / (1024.0 * 1024.0), r.seconds);
+                exportStatus = line;
+            }
+            if (exportJob.valid()) {
+                ImGui::Text("Exporting...");
+            } else {
+                if (ImGui::Button("Heightmap raster (whole map)")) {
+                    std::shared_ptr<const ElevationMap> snap = frameMap;
+                    exportJob = std::async(std::launch::async, [snap] {
+                        return exportHeightRaster(*snap, "elevation.raster");
+                    });
+                }
+                ImGui::SliderFloat("Mesh radius (m)", &exportRadius, 25.0f, 2000.0f);
+                if (ImGui::Button("PLY mesh around selected rover")) {
+                    const PoseEstimate pose = roverPose(selectedRover);
+                    const ExportRegion region{pose.posX - exportRadius, pose.posZ - exportRadius,
+                                              pose.posX + exportRadius, pose.posZ + exportRadius};
+                    std::shared_ptr<const ElevationMap> snap = frameMap;
+                    exportJob = std::async(std::launch::async, [snap, region] {
+                        return exportPlyMesh(*snap, "elevation.ply", region);
+                    });
+                }
+            }
+            if (!exportStatus.empty()) ImGui::TextUnformatted(exportStatus.c_str());
+        }
+
         // Mini-map removed per request
 
         if (ImGui::CollapsingHeader("Camera", ImGuiTreeNodeFlags_DefaultOpen)) {
@@ -286,6 +611,13 @@ int main() {
         ImGui::Checkbox("Free-fly (WASD + mouse)", &freeFly);
         followSelected = !freeFly;
         ImGui::SliderFloat3("Follow offset", &followOffset.x, -200.0f, 200.0f);
+        ImGui::Checkbox("Avoid terrain occlusion", &avoidTerrainOcclusion);
+        if (cursorHitValid) {
+            ImGui::Text("Cursor: %.2f %.2f %.2f (n=%u%s)", cursorHit.x, cursorHit.y, cursorHit.z,
+                        (unsigned)cursorHit.n, cursorHit.confident ? "" : ", unconfirmed");
+        } else {
+            ImGui::Text("Cursor: -");
+        }
         if (freeFly) {
             ImGui::SliderFloat("Fly speed", &flySpeed, 1.0f, 100.0f);
             ImGui::SliderFloat("Yaw", &yawDeg, -180.0f, 180.0f);
@@ -392,7 +724,7 @@ int main() {
         }
         // Follow mode updates
         if (followSelected && !freeFly && !suppressFollowOnce) {
-            const auto& p = roverState[selectedRover].lastPose;
+            const PoseEstimate p = roverPose(selectedRover);
             // Update smoothed position for the selected rover (EMA with ~0.3s time constant)
             auto &sp = smoothedPos[selectedRover];
             if (sp == glm::vec3(0.0f)) {
@@ -409,6 +741,15 @@ int main() {
             camTargetSmoothed = camTargetSmoothed + alphaT * (sp - camTargetSmoothed);
             camTarget = camTargetSmoothed;
             camPos = camTarget + followOffset;
+            if (avoidTerrainOcclusion && followRadius > 2.0f) {
+                // Cast from just outside the rover toward the camera; pull in if terrain is in the way
+                glm::vec3 dir = followOffset / followRadius;
+                glm::vec3 start = camTarget + dir * 2.0f;
+                RayHit hit;
+                if (frameMap->raycast(start.x, start.y, start.z, dir.x, dir.y, dir.z, followRadius - 2.0f, &hit)) {
+                    camPos = camTarget + dir * std::max(2.0f, 2.0f + hit.distance - 0.5f);
+                }
+            }
         }
         // Keyboard center hotkey (edge-triggered) -> set pending flag
         {
@@ -417,15 +758,39 @@ int main() {
             centerKeyDownPrev = cDown;
         }
 
+        // Terrain under the cursor, using last frame's camera. Middle click in free-fly focuses on it.
+        {
+            ImGuiIO& io = ImGui::GetIO();
+            cursorHitValid = false;
+            if (!io.WantCaptureMouse && io.DisplaySize.x > 0.0f && io.DisplaySize.y > 0.0f) {
+                float nx = 2.0f * io.MousePos.x / io.DisplaySize.x - 1.0f;
+                float ny = 1.0f - 2.0f * io.MousePos.y / io.DisplaySize.y;
+                glm::mat4 inv = glm::inverse(lastViewProj);
+                glm::vec4 pn = inv * glm::vec4(nx, ny, -1.0f, 1.0f);
+                glm::vec4 pf = inv * glm::vec4(nx, ny, 1.0f, 1.0f);
+                if (fabsf(pn.w) > 1e-6f && fabsf(pf.w) > 1e-6f) {
+                    glm::vec3 a = glm::vec3(pn) / pn.w;
+                    glm::vec3 d = glm::vec3(pf) / pf.w - a;
+                    cursorHitValid = frameMap->raycast(a.x, a.y, a.z, d.x, d.y, d.z, glm::length(d), &cursorHit);
+                }
+                if (cursorHitValid && freeFly && ImGui::IsMouseClicked(ImGuiMouseButton_Middle)) {
+                    pendingCenter = true;
+                    pendingFocus = true;
+                }
+            }
+        }
+
         // Apply pending center AFTER follow/free-fly camera updates to avoid flicker
         if (pendingCenter) {
-            const auto& p = roverState[selectedRover].lastPose;
+            const PoseEstimate p = roverPose(selectedRover);
             auto itSp = smoothedPos.find(selectedRover);
             glm::vec3 base = (itSp != smoothedPos.end() && itSp->second != glm::vec3(0.0f))
                              ? itSp->second
                              : glm::vec3(p.posX, p.posY, p.posZ);
             float gy = base.y; uint16_t gn = 0;
-            if (elevMap.getGroundAt(base.x, base.z, &gy, &gn)) {
+            if (pendingFocus) {
+                camTarget = {cursorHit.x, cursorHit.y, cursorHit.z};
+            } else if (frameMap->getGroundAt(base.x, base.z, &gy, &gn)) {
                 camTarget = {base.x, gy + 0.8f, base.z};
             } else {
                 camTarget = base;
@@ -441,11 +806,13 @@ int main() {
                 if (pitchDeg > 89.0f) pitchDeg = 89.0f; if (pitchDeg < -89.0f) pitchDeg = -89.0f;
             }
             pendingCenter = false;
+            pendingFocus = false;
             suppressFollowOnce = false;
         }
         glm::mat4 proj = glm::perspective(glm::radians(fovDeg), aspect, 0.1f, 500.0f);
         glm::mat4 view = glm::lookAt(camPos, camTarget, worldUp);
         renderer.setViewProjection(view, proj);
+        lastViewProj = proj * view;
         // Ensure rover rendering ignores terrain orientation for stability
         renderer.setAlignToTerrain(false);
         renderer.renderFrame(assembler.getGlobalTerrain(), fps, (int)assembler.getGlobalTerrain().size());
@@ -458,6 +825,9 @@ int main() {
     }
 
     net.stop();
+    mappingRunning = false;
+    mappingThread.join();
+    elevMap.flushTileStore();
     renderer.shutdown();
     shutdownImGui();
     glfwDestroyWindow(window);